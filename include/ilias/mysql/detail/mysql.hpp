@@ -18,16 +18,27 @@
 #include <ilias/net/sockfd.hpp>
 #include <ilias/task/when_any.hpp>
 #include <ilias/task/decorator.hpp>
+#include <ilias/sync/event.hpp>
 #include <mariadb/mysql.h>
+#include <deque>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "../sqlerror.hpp"
 #include "global.hpp"
 #include "sqlopt.hpp"
+#include "sqlresolver.hpp"
+#include "stmtcache.hpp"
 
 ILIAS_SQL_NS_BEGIN
 namespace detail {
 
-class MySql final {
+class SqlReaper;
+
+class MySql final : public std::enable_shared_from_this<MySql> {
 public:
     enum ShutdownType {
         SHUTDOWN_DEFAULT = ::mysql_enum_shutdown_level::SHUTDOWN_DEFAULT,
@@ -46,6 +57,9 @@ public:
     ~MySql();
 
     // connect
+    ///> the host is resolved by SqlResolver and every address is tried in turn, on by default. The connector then
+    ///> only knows the address, the host is left to it when a TLS option or CLIENT_SSL is set.
+    auto setResolveHost(bool resolve) -> void { mResolveHost = resolve; }
     [[nodiscard("Don't forget to use co_await")]]
     auto connect(std::string_view host, std::string_view user, std::string_view passwd, std::string_view db,
                  int port = 3306, std::string_view unix_socket = "", unsigned long client_flag = 0) -> IoTask<void>;
@@ -89,6 +103,17 @@ public:
     auto stat() -> IoTask<const char *>;
     [[nodiscard("Don't forget to use co_await")]]
     auto readQueryResult() -> IoTask<void>;
+    ///> the next response is one of a command sent before others, the server numbers every response from 1.
+    auto resetSequence() -> void;
+    auto moreResults() -> bool;
+    ///> MULTI_STATEMENTS_ON was set or the connection was opened with CLIENT_MULTI_STATEMENTS.
+    auto multiStatements() -> bool;
+    auto affectedRows() -> uint64_t;
+    auto insertId() -> uint64_t;
+    auto warningCount() -> unsigned int;
+    ///> read and free the result sets left of the current query (a CALL, a multi statement query).
+    [[nodiscard("Don't forget to use co_await")]]
+    auto discardResults() -> IoTask<void>;
 
     // useResult -> fetchRow -> freeResult
     [[nodiscard("Don't forget to use co_await")]]
@@ -108,18 +133,114 @@ public:
 
     // stmt
     auto stmtInit() -> MYSQL_STMT *;
+    auto stmtCache() -> SqlStmtCache &;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto stmtPrepare(MYSQL_STMT *stmt, std::string_view sql) -> IoTask<void>;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto stmtExecute(MYSQL_STMT *stmt) -> IoTask<void>;
+    ///> one chunk of a long parameter, the chunks are joined by the server until the next execute.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto stmtSendLongData(MYSQL_STMT *stmt, unsigned int index, std::span<const std::byte> data) -> IoTask<void>;
+    ///> COM_STMT_RESET, drops the long data sent so far and the unread rows of the statement.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto stmtReset(MYSQL_STMT *stmt) -> IoTask<void>;
+    ///> server accepts STMT_ATTR_ARRAY_SIZE executes (mariadb 10.2 and later).
+    auto supportsBulk() -> bool;
     auto setOpt(const sqlopt::OptionBase &opt) -> int;
     auto getOpt(sqlopt::OptionBase &opt) -> int;
     auto close() -> void;
     auto lastError() -> SqlError;
     auto lastErrorMessage() -> const char *;
 
+    // teardown left by destructors, it runs before the next command of the connection or in the reaper.
+    ///> read the unread rows of a streamed result (pending) then free it.
+    auto deferFreeResult(MYSQL_RES *result, bool pending) -> void;
+    ///> free the result of a statement, reset it first when it has unread rows or an open cursor (pending). a statement
+    ///> that isn't borrowed goes back to the cache or is closed.
+    auto deferFreeStmt(MYSQL_STMT *stmt, MYSQL_RES *metadata, bool pending, bool borrowed) -> void;
+    ///> COM_STMT_CLOSE has no response, the statements closed until the next command are sent back to back.
+    auto deferStmtClose(MYSQL_STMT *stmt) -> void;
+    ///> read and free the result sets left of the current query.
+    auto deferDiscardResults() -> void;
+    ///> MULTI_STATEMENTS_OFF once the results of a multi statement query are read, before the next command.
+    auto deferMultiStatementsOff() -> void;
+    ///> hand the connection to the reaper of its IoContext, it is closed there when nobody else holds it.
+    auto retire() -> void;
+    ///> run the teardown left on the connection, commands call it before they start.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto settle() -> IoTask<void>;
+    auto hasTeardown() const -> bool { return mSettling != nullptr || !mTeardown.empty() || !mStmtCloses.empty(); }
+
     bool operator==(MySql &other);
 
 private:
-    IoContext *mCtxt = nullptr;
-    MYSQL      mMysql;
-    Poller     mPoller;
+    struct Teardown {
+        enum Kind : uint8_t { FreeResult, FreeStmt, DiscardResults, MultiStatementsOff };
+        Kind        kind;
+        MYSQL_RES  *result   = nullptr;
+        MYSQL_STMT *stmt     = nullptr;
+        bool        pending  = false;
+        bool        borrowed = false;
+    };
+
+    [[nodiscard("Don't forget to use co_await")]]
+    auto runTeardown(Teardown &item) -> IoTask<void>;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto closeStmts(std::vector<MYSQL_STMT *> stmts) -> IoTask<void>;
+    auto abandonTeardown() -> void;
+    auto usesTls(unsigned long clientFlag) -> bool;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto realConnect(const char *host, const char *user, const char *passwd, const char *db, int port,
+                     const char *unixSocket, unsigned long clientFlag) -> IoTask<void>;
+
+    IoContext                *mCtxt = nullptr;
+    MYSQL                     mMysql;
+    Poller                    mPoller;
+    SqlStmtCache              mStmtCache;
+    bool                      mMultiStatements = false;
+    bool                      mResolveHost     = true;
+    bool                      mClosed          = false;
+    bool                      mRetired         = false; // queued in the reaper
+    std::deque<Teardown>      mTeardown;
+    std::vector<MYSQL_STMT *> mStmtCloses;
+    std::shared_ptr<Event>    mSettling; // set when the running settle() is done
+
+    friend class SqlReaper;
+};
+
+/**
+ * @brief The teardown of dying results, statements and connections of one IoContext, so none of them blocks the
+ * event loop in a destructor.
+ *
+ * Destructors leave their work on the connection (MySql::defer...) and retire it here. The reaper task runs while
+ * connections are queued: when it holds the last reference it settles the connection, then closes it with
+ * mysql_close_start/cont. A connection still in use is left to its next command, every command waits for its
+ * teardown first.
+ *
+ * The task runs on the IoContext, await drain() before the context is torn down. A connection left queued is closed
+ * with the blocking mysql_close when the reaper is destroyed at thread exit.
+ */
+class SqlReaper {
+public:
+    SqlReaper() = default;
+    ~SqlReaper();
+
+    ///> the reaper of the IoContext of the current thread.
+    static auto current() -> SqlReaper &;
+    static auto of(IoContext &ctxt) -> SqlReaper &;
+
+    auto retire(std::shared_ptr<MySql> mysql) -> void;
+    ///> wait until the connections retired so far are settled and the ones nobody holds are closed.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto drain() -> IoTask<void>;
+    auto idle() const -> bool { return mIdle == nullptr; }
+
+private:
+    [[nodiscard("Don't forget to use co_await")]]
+    auto run() -> IoTask<void>;
+
+    std::deque<std::shared_ptr<MySql>> mQueue;
+    std::shared_ptr<Event>             mIdle; // set when the running reaper task is done
 };
 
 inline MySql::MySql() {
@@ -136,6 +257,8 @@ inline MySql::MySql() {
     if (ret != 0) {
         ILIAS_ERROR("sql", "mysql set option failed, {}", SqlError(static_cast<SqlError::Code>(ret)).message());
     }
+    // evictions happen on the way to a command, their COM_STMT_CLOSE are sent with it.
+    mStmtCache.setCloser([this](MYSQL_STMT *stmt) { deferStmtClose(stmt); });
 }
 
 inline bool MySql::operator==(MySql &other) {
@@ -221,6 +344,15 @@ inline auto MySql::pollStatus(int &status, uint32_t pollEvents) -> IoTask<void>
         }                                                                                                              \
     }
 
+// a command waits for the teardown left on the connection, the responses it reads have to be its own.
+#define SQL_PRIVATE_SETTLE                                                                                             \
+    if (hasTeardown()) {                                                                                               \
+        auto settled = co_await settle();                                                                              \
+        if (!settled) {                                                                                                \
+            co_return Unexpected<Error>(settled.error());                                                              \
+        }                                                                                                              \
+    }
+
 #define SQL_PRIVATE_SYNC_CODE(OutP, MysqlFunc, ...)                                                                    \
     auto status = MysqlFunc##_start(&OutP, &mMysql, ##__VA_ARGS__);                                                    \
     if (status) {                                                                                                      \
@@ -240,7 +372,7 @@ inline auto MySql::pollStatus(int &status, uint32_t pollEvents) -> IoTask<void>
                 return true;                                                                                           \
         }                                                                                                              \
         else if constexpr (std::is_same_v<decltype(p), my_bool>) {                                                     \
-            if (p)                                                                                                     \
+            if (!p)                                                                                                    \
                 return true;                                                                                           \
         }                                                                                                              \
         else if constexpr (std::is_integral_v<decltype(p)>) {                                                          \
@@ -263,23 +395,77 @@ inline auto MySql::pollStatus(int &status, uint32_t pollEvents) -> IoTask<void>
 
 inline auto MySql::connect(std::string_view host, std::string_view user, std::string_view passwd, std::string_view db,
                            int port, std::string_view unix_socket, unsigned long client_flag) -> IoTask<void> {
-    MYSQL      *ret;
     std::string targetHost(host);
     std::string targetUser(user);
     std::string targetPasswd(passwd);
     std::string targetDb(db);
+    std::string targetSocket(unix_socket);
+
+    // the connector would resolve a host name with a blocking getaddrinfo, it gets the addresses one by one instead.
+    if (!mResolveHost || !unix_socket.empty() || SqlResolver::isLiteral(host) || usesTls(client_flag)) {
+        co_return co_await realConnect(host == "" ? nullptr : targetHost.c_str(), targetUser.c_str(),
+                                       targetPasswd.c_str(), targetDb.c_str(), port,
+                                       unix_socket == "" ? nullptr : targetSocket.c_str(), client_flag);
+    }
+    auto addresses = co_await SqlResolver::current().resolve(host);
+    if (!addresses) {
+        co_return Unexpected<Error>(addresses.error());
+    }
+    Result<void> ret;
+    for (auto &address : addresses.value()) {
+        ILIAS_TRACE("sql", "connect {} at {}", targetHost, address);
+        ret = co_await realConnect(address.c_str(), targetUser.c_str(), targetPasswd.c_str(), targetDb.c_str(), port,
+                                   nullptr, client_flag);
+        if (ret) {
+            co_return {};
+        }
+        // the socket of the failed attempt is closed, its descriptor number may come back with the next one.
+        mPoller.close();
+    }
+    // the host may have moved (a failover), it is looked up again by the next connect.
+    SqlResolver::current().forget(host);
+    co_return ret;
+}
 
-    SQL_PRIVATE_SYNC_CODE(ret, mysql_real_connect, host == "" ? nullptr : targetHost.c_str(), targetUser.c_str(),
-                          targetPasswd.c_str(), targetDb.c_str(), port,
-                          unix_socket == "" ? nullptr : unix_socket.data(), client_flag)
+// the server certificate is checked against the host given to the connector, an address would fail the check.
+inline auto MySql::usesTls(unsigned long clientFlag) -> bool {
+    if (clientFlag & CLIENT_SSL) {
+        return true;
+    }
+    for (auto option : {MYSQL_OPT_SSL_VERIFY_SERVER_CERT, MYSQL_OPT_SSL_ENFORCE}) {
+        my_bool value = 0;
+        if (mysql_get_optionv(&mMysql, option, &value) == 0 && value) {
+            return true;
+        }
+    }
+    for (auto option : {MYSQL_OPT_SSL_KEY, MYSQL_OPT_SSL_CERT, MYSQL_OPT_SSL_CA, MYSQL_OPT_SSL_CAPATH,
+                        MYSQL_OPT_SSL_CIPHER, MYSQL_OPT_SSL_CRL, MYSQL_OPT_SSL_CRLPATH, MARIADB_OPT_TLS_PEER_FP,
+                        MARIADB_OPT_TLS_PEER_FP_LIST, MARIADB_OPT_TLS_VERSION}) {
+        const char *value = nullptr;
+        if (mysql_get_optionv(&mMysql, option, &value) == 0 && value != nullptr && *value != '\0') {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline auto MySql::realConnect(const char *host, const char *user, const char *passwd, const char *db, int port,
+                               const char *unixSocket, unsigned long clientFlag) -> IoTask<void> {
+    MYSQL *ret;
+    SQL_PRIVATE_SYNC_CODE(ret, mysql_real_connect, host, user, passwd, db, port, unixSocket, clientFlag)
     co_return {};
 }
 
 inline auto MySql::resetConnection() -> IoTask<int> {
-
     // this ret is what.
     int ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_reset_connection);
+    // the server deallocated every prepared statement of the session and the reset detached them from the
+    // connection, closing them only frees their memory.
+    for (auto stmt : mStmtCache.detach()) {
+        mysql_stmt_close(stmt);
+    }
     co_return {};
 }
 
@@ -290,19 +476,32 @@ inline auto MySql::changeUser(std::string_view user, std::string_view passwd, st
     std::string localUser(user);
     std::string localPasswd(passwd);
     std::string localDb(db);
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_change_user, localUser.c_str(), localPasswd.c_str(), localDb.c_str())
     co_return {};
 }
 
 inline auto MySql::close() -> void {
+    if (mClosed) {
+        return;
+    }
     ILIAS_TRACE("sql", "close mysql connection");
+    // closed first, a statement evicted by the teardown is then closed right away.
+    mClosed = true;
+    abandonTeardown();
+    // mysql_close detaches the cached statements, they are freed without a COM_STMT_CLOSE each.
+    auto stmts = mStmtCache.detach();
     mPoller.close();
     mysql_close(&mMysql);
+    for (auto stmt : stmts) {
+        mysql_stmt_close(stmt);
+    }
 }
 
 inline auto MySql::dumpDebugInfo() -> IoTask<void> {
     // this ret is what.
     int ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_dump_debug_info)
     co_return {};
 }
@@ -311,7 +510,9 @@ inline auto MySql::setServerOption(ServerOption option) -> IoTask<void> {
 
     // this ret is what.
     int ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_set_server_option, static_cast<enum_mysql_set_option>(option))
+    mMultiStatements = option == MULTI_STATEMENTS_ON;
     co_return {};
 }
 
@@ -319,6 +520,7 @@ inline auto MySql::setCharacterSet(std::string_view csname) -> IoTask<void> {
     // this ret is what.
     int         ret;
     std::string localCsname(csname);
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_set_character_set, localCsname.c_str())
     co_return {};
 }
@@ -328,12 +530,14 @@ inline auto MySql::selectDb(std::string_view db) -> IoTask<void> {
     // this ret is what.
     int         ret;
     std::string localDb(db);
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_select_db, localDb.c_str())
     co_return {};
 }
 
 inline auto MySql::query(std::string_view sql) -> IoTask<void> {
     int ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_real_query, sql.data(), (uint32_t)sql.size())
     // can use mysql_num_fields() to determine if a statement returned a result set.
     co_return {};
@@ -342,11 +546,24 @@ inline auto MySql::query(std::string_view sql) -> IoTask<void> {
 inline auto MySql::commit() -> IoTask<void> {
 
     my_bool ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_commit)
     co_return {};
 }
 
 inline auto MySql::disconnect() -> IoTask<void> {
+    if (mClosed) {
+        co_return {};
+    }
+    if (hasTeardown()) {
+        auto settled = co_await settle();
+        if (!settled) {
+            ILIAS_WARN("sql", "teardown before disconnect failed, {}", settled.error().message());
+        }
+    }
+    mClosed = true;
+    // mysql_close detaches the cached statements, they are freed without a COM_STMT_CLOSE each.
+    auto stmts = mStmtCache.detach();
     mPoller.close();
     auto status = mysql_close_start(&mMysql);
     if (status) {
@@ -360,6 +577,9 @@ inline auto MySql::disconnect() -> IoTask<void> {
             }
         }
     }
+    for (auto stmt : stmts) {
+        mysql_stmt_close(stmt);
+    }
     ILIAS_TRACE("sql", "close mysql connection");
     co_return {};
 }
@@ -367,6 +587,7 @@ inline auto MySql::disconnect() -> IoTask<void> {
 inline auto MySql::autoCommit(bool autoMode) -> IoTask<void> {
     // TODO: need query "select @@autocommit;" and get the result.
     my_bool ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_autocommit, autoMode)
     co_return {};
 }
@@ -381,8 +602,14 @@ inline auto MySql::fieldCount() -> std::size_t {
     return mysql_field_count(&mMysql);
 }
 
+// mysql_use_result only sets up the row reader, the rows are read by mysql_fetch_row_start/cont.
 inline auto MySql::useResult() -> IoTask<MYSQL_RES *> {
-    co_return mysql_use_result(&mMysql);
+    auto result = mysql_use_result(&mMysql);
+    if (result == nullptr && mysql_errno(&mMysql) != 0) {
+        ILIAS_ERROR("sql", "mysql_use_result failed, error({}): {}", mysql_errno(&mMysql), mysql_error(&mMysql));
+        co_return Unexpected<Error>((SqlError::Code)mysql_errno(&mMysql));
+    }
+    co_return result;
 }
 
 inline auto MySql::storeResult(MYSQL_RES **result) -> IoTask<void> {
@@ -392,6 +619,7 @@ inline auto MySql::storeResult(MYSQL_RES **result) -> IoTask<void> {
 
 inline auto MySql::rollback() -> IoTask<void> {
     my_bool ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_rollback)
     co_return {};
 }
@@ -399,36 +627,43 @@ inline auto MySql::rollback() -> IoTask<void> {
 inline auto MySql::listFields(MYSQL_RES **ret, std::string_view table, std::string_view wildcard) -> IoTask<void> {
     std::string localTable(table);
     std::string localWildcard(wildcard);
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(*ret, mysql_list_fields, localTable.c_str(), localWildcard.c_str());
     co_return {};
 }
 
+// only writes the query, its response is read by readQueryResult().
 inline auto MySql::sendQuery(std::string_view sql) -> IoTask<void> {
     int ret;
-    SQL_PRIVATE_SYNC_CODE(ret, mysql_real_query, sql.data(), (uint32_t)sql.size())
+    SQL_PRIVATE_SETTLE
+    SQL_PRIVATE_SYNC_CODE(ret, mysql_send_query, sql.data(), (unsigned long)sql.size())
     co_return {};
 }
 
 inline auto MySql::refresh(uint32_t refreshOptions) -> IoTask<void> {
     int ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_refresh, refreshOptions)
     co_return {};
 }
 
 inline auto MySql::kill(uint64_t pid) -> IoTask<void> {
     int ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_kill, pid)
     co_return {};
 }
 
 inline auto MySql::ping() -> IoTask<int> {
     int ret;
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_ping)
     co_return ret;
 }
 
 inline auto MySql::stat() -> IoTask<const char *> {
     const char *ret; // FIXME: this var's live who knows ?
+    SQL_PRIVATE_SETTLE
     SQL_PRIVATE_SYNC_CODE(ret, mysql_stat)
     co_return ret;
 }
@@ -439,6 +674,55 @@ inline auto MySql::readQueryResult() -> IoTask<void> {
     co_return {};
 }
 
+inline auto MySql::resetSequence() -> void {
+    mMysql.net.pkt_nr          = 1;
+    mMysql.net.compress_pkt_nr = 1;
+}
+
+inline auto MySql::moreResults() -> bool {
+    return mysql_more_results(&mMysql);
+}
+
+inline auto MySql::multiStatements() -> bool {
+    return mMultiStatements || (mMysql.client_flag & CLIENT_MULTI_STATEMENTS) != 0;
+}
+
+inline auto MySql::affectedRows() -> uint64_t {
+    return mysql_affected_rows(&mMysql);
+}
+
+inline auto MySql::insertId() -> uint64_t {
+    return mysql_insert_id(&mMysql);
+}
+
+inline auto MySql::warningCount() -> unsigned int {
+    return mysql_warning_count(&mMysql);
+}
+
+inline auto MySql::discardResults() -> IoTask<void> {
+    while (moreResults()) {
+        auto ret = co_await (nextResult() | ignoreCancellation);
+        if (!ret) {
+            if (ret.error() == SqlError::Code::OK) {
+                break;
+            }
+            co_return Unexpected<Error>(ret.error());
+        }
+        if (fieldCount() == 0) {
+            continue;
+        }
+        MYSQL_RES *result = nullptr;
+        ret               = co_await (storeResult(&result) | ignoreCancellation);
+        if (result != nullptr) {
+            mysql_free_result(result);
+        }
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+    }
+    co_return {};
+}
+
 inline auto MySql::setOpt(const sqlopt::OptionBase &opt) -> int {
     return opt.setopt(mMysql);
 }
@@ -451,6 +735,92 @@ inline auto MySql::stmtInit() -> MYSQL_STMT * {
     return mysql_stmt_init(&mMysql);
 }
 
+inline auto MySql::stmtCache() -> SqlStmtCache & {
+    return mStmtCache;
+}
+
+inline auto MySql::stmtPrepare(MYSQL_STMT *stmt, std::string_view sql) -> IoTask<void> {
+    SQL_PRIVATE_SETTLE
+    int  ret;
+    auto status = mysql_stmt_prepare_start(&ret, stmt, sql.data(), (unsigned long)sql.size());
+    while (status) {
+        ILIAS_TRACE("sql", "stmt prepare waiting for status {}", status);
+        auto pret = co_await (pollStatus(status) | ignoreCancellation);
+        if (!pret) {
+            co_return Unexpected<Error>(pret.error());
+        }
+        status = mysql_stmt_prepare_cont(&ret, stmt, status);
+    }
+    if (ret != 0) {
+        ILIAS_ERROR("sql", "stmt prepare failed, error({}): {}", mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+        co_return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(stmt));
+    }
+    co_return {};
+}
+
+inline auto MySql::stmtExecute(MYSQL_STMT *stmt) -> IoTask<void> {
+    SQL_PRIVATE_SETTLE
+    int  ret;
+    auto status = mysql_stmt_execute_start(&ret, stmt);
+    while (status) {
+        ILIAS_TRACE("sql", "stmt execute waiting for status {}", status);
+        auto pret = co_await (pollStatus(status) | ignoreCancellation);
+        if (!pret) {
+            co_return Unexpected<Error>(pret.error());
+        }
+        status = mysql_stmt_execute_cont(&ret, stmt, status);
+    }
+    if (ret != 0) {
+        ILIAS_ERROR("sql", "stmt execute failed, error({}): {}", mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+        co_return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(stmt));
+    }
+    co_return {};
+}
+
+inline auto MySql::stmtSendLongData(MYSQL_STMT *stmt, unsigned int index, std::span<const std::byte> data)
+    -> IoTask<void> {
+    SQL_PRIVATE_SETTLE
+    my_bool ret;
+    auto    status = mysql_stmt_send_long_data_start(&ret, stmt, index, reinterpret_cast<const char *>(data.data()),
+                                                     (unsigned long)data.size());
+    while (status) {
+        ILIAS_TRACE("sql", "stmt send long data waiting for status {}", status);
+        auto pret = co_await (pollStatus(status) | ignoreCancellation);
+        if (!pret) {
+            co_return Unexpected<Error>(pret.error());
+        }
+        status = mysql_stmt_send_long_data_cont(&ret, stmt, status);
+    }
+    if (ret != 0) {
+        ILIAS_ERROR("sql", "stmt send long data failed, error({}): {}", mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+        co_return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(stmt));
+    }
+    co_return {};
+}
+
+inline auto MySql::stmtReset(MYSQL_STMT *stmt) -> IoTask<void> {
+    SQL_PRIVATE_SETTLE
+    my_bool ret;
+    auto    status = mysql_stmt_reset_start(&ret, stmt);
+    while (status) {
+        ILIAS_TRACE("sql", "stmt reset waiting for status {}", status);
+        auto pret = co_await (pollStatus(status) | ignoreCancellation);
+        if (!pret) {
+            co_return Unexpected<Error>(pret.error());
+        }
+        status = mysql_stmt_reset_cont(&ret, stmt, status);
+    }
+    if (ret != 0) {
+        ILIAS_ERROR("sql", "stmt reset failed, error({}): {}", mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+        co_return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(stmt));
+    }
+    co_return {};
+}
+
+inline auto MySql::supportsBulk() -> bool {
+    return mariadb_connection(&mMysql) && mysql_get_server_version(&mMysql) >= 100200;
+}
+
 inline auto MySql::lastError() -> SqlError {
     return (SqlError::Code)mysql_errno(&mMysql);
 }
@@ -459,6 +829,241 @@ inline auto MySql::lastErrorMessage() -> const char * {
     return mysql_error(&mMysql);
 }
 
+inline auto MySql::deferFreeResult(MYSQL_RES *result, bool pending) -> void {
+    mTeardown.push_back(Teardown {Teardown::FreeResult, result, nullptr, pending});
+    retire();
+}
+
+inline auto MySql::deferFreeStmt(MYSQL_STMT *stmt, MYSQL_RES *metadata, bool pending, bool borrowed) -> void {
+    mTeardown.push_back(Teardown {Teardown::FreeStmt, metadata, stmt, pending, borrowed});
+    retire();
+}
+
+inline auto MySql::deferStmtClose(MYSQL_STMT *stmt) -> void {
+    mStmtCloses.push_back(stmt);
+    retire();
+}
+
+inline auto MySql::deferDiscardResults() -> void {
+    mTeardown.push_back(Teardown {Teardown::DiscardResults});
+    retire();
+}
+
+inline auto MySql::deferMultiStatementsOff() -> void {
+    mTeardown.push_back(Teardown {Teardown::MultiStatementsOff});
+    retire();
+}
+
+// nothing can be sent on a closed connection, what is left only frees memory.
+inline auto MySql::retire() -> void {
+    if (mClosed) {
+        abandonTeardown();
+        return;
+    }
+    if (mRetired || mCtxt == nullptr) {
+        return;
+    }
+    mRetired = true;
+    SqlReaper::of(*mCtxt).retire(shared_from_this());
+}
+
+// the teardown runs in the order it was left, the statements to close go last: a queued result may still use one.
+inline auto MySql::settle() -> IoTask<void> {
+    while (mSettling != nullptr) {
+        auto settling = mSettling;
+        co_await *settling;
+    }
+    if (mTeardown.empty() && mStmtCloses.empty()) {
+        co_return {};
+    }
+    auto settling = std::make_shared<Event>();
+    mSettling     = settling;
+    while (!mTeardown.empty() || !mStmtCloses.empty()) {
+        Result<void> ret;
+        if (!mTeardown.empty()) {
+            auto item = mTeardown.front();
+            mTeardown.pop_front();
+            ret = co_await runTeardown(item);
+        }
+        else {
+            ret = co_await closeStmts(std::exchange(mStmtCloses, {}));
+        }
+        if (!ret) {
+            ILIAS_WARN("sql", "connection teardown failed, {}", ret.error().message());
+        }
+    }
+    mSettling = nullptr;
+    settling->set();
+    co_return {};
+}
+
+inline auto MySql::runTeardown(Teardown &item) -> IoTask<void> {
+    Result<void> ret;
+    if (item.kind == Teardown::FreeResult) {
+        // read what is left of a streamed result, mysql_free_result would skip it with blocking reads.
+        while (item.pending) {
+            MYSQL_ROW row    = nullptr;
+            auto      status = mysql_fetch_row_start(&row, item.result);
+            while (status) {
+                auto pret = co_await (pollStatus(status) | ignoreCancellation);
+                if (!pret) {
+                    ret = Unexpected<Error>(pret.error());
+                    break;
+                }
+                status = mysql_fetch_row_cont(&row, item.result, status);
+            }
+            item.pending = ret && row != nullptr;
+        }
+        mysql_free_result(item.result);
+    }
+    else if (item.kind == Teardown::FreeStmt) {
+        if (item.result != nullptr) {
+            mysql_free_result(item.result);
+        }
+        if (item.pending) {
+            // skip the unread rows / close the cursor, mysql_stmt_free_result would do it synchronously.
+            my_bool reset;
+            auto    status = mysql_stmt_reset_start(&reset, item.stmt);
+            while (status) {
+                auto pret = co_await (pollStatus(status) | ignoreCancellation);
+                if (!pret) {
+                    ret = Unexpected<Error>(pret.error());
+                    break;
+                }
+                status = mysql_stmt_reset_cont(&reset, item.stmt, status);
+            }
+        }
+        mysql_stmt_free_result(item.stmt);
+        if (!item.borrowed && !mStmtCache.release(item.stmt)) {
+            mStmtCloses.push_back(item.stmt);
+        }
+    }
+    else if (item.kind == Teardown::DiscardResults) {
+        ret = co_await discardResults();
+    }
+    else {
+        // setServerOption() would wait for this teardown.
+        int  option = 0;
+        auto status = mysql_set_server_option_start(&option, &mMysql, MYSQL_OPTION_MULTI_STATEMENTS_OFF);
+        while (status) {
+            auto pret = co_await (pollStatus(status) | ignoreCancellation);
+            if (!pret) {
+                ret = Unexpected<Error>(pret.error());
+                break;
+            }
+            status = mysql_set_server_option_cont(&option, &mMysql, status);
+        }
+        if (ret && option != 0) {
+            ret = Unexpected<Error>(lastError().error());
+        }
+        if (ret) {
+            mMultiStatements = false;
+        }
+    }
+    co_return ret;
+}
+
+// COM_STMT_CLOSE has no response, each close is a write that doesn't wait for the one before.
+inline auto MySql::closeStmts(std::vector<MYSQL_STMT *> stmts) -> IoTask<void> {
+    ILIAS_TRACE("sql", "close {} statements", stmts.size());
+    Result<void> ret;
+    for (auto stmt : stmts) {
+        my_bool closed;
+        auto    status = mysql_stmt_close_start(&closed, stmt);
+        while (status) {
+            auto pret = co_await (pollStatus(status) | ignoreCancellation);
+            if (!pret) {
+                ret = Unexpected<Error>(pret.error());
+                break;
+            }
+            status = mysql_stmt_close_cont(&closed, stmt, status);
+        }
+    }
+    co_return ret;
+}
+
+// the connection is closed before its teardown ran, what is left is done with blocking calls.
+inline auto MySql::abandonTeardown() -> void {
+    for (auto &item : std::exchange(mTeardown, {})) {
+        if (item.kind == Teardown::FreeResult) {
+            mysql_free_result(item.result);
+        }
+        else if (item.kind == Teardown::FreeStmt) {
+            if (item.result != nullptr) {
+                mysql_free_result(item.result);
+            }
+            mysql_stmt_free_result(item.stmt);
+            if (!item.borrowed && !mStmtCache.release(item.stmt)) {
+                mysql_stmt_close(item.stmt);
+            }
+        }
+    }
+    for (auto stmt : std::exchange(mStmtCloses, {})) {
+        mysql_stmt_close(stmt);
+    }
+}
+
+inline auto SqlReaper::current() -> SqlReaper & {
+    return of(*IoContext::currentThread());
+}
+
+// an IoContext is driven by one thread, so are the reapers of the contexts of a thread.
+inline auto SqlReaper::of(IoContext &ctxt) -> SqlReaper & {
+    static thread_local std::unordered_map<IoContext *, std::unique_ptr<SqlReaper>> reapers;
+    auto &reaper = reapers[&ctxt];
+    if (reaper == nullptr) {
+        reaper = std::make_unique<SqlReaper>();
+    }
+    return *reaper;
+}
+
+inline SqlReaper::~SqlReaper() {
+    if (!mQueue.empty()) {
+        ILIAS_WARN("sql", "{} connections left in the reaper, drain it before its IoContext is gone", mQueue.size());
+    }
+}
+
+inline auto SqlReaper::retire(std::shared_ptr<MySql> mysql) -> void {
+    mQueue.push_back(std::move(mysql));
+    if (mIdle == nullptr) {
+        mIdle = std::make_shared<Event>();
+        ilias_go run();
+    }
+}
+
+inline auto SqlReaper::drain() -> IoTask<void> {
+    while (mIdle != nullptr) {
+        auto idle = mIdle;
+        co_await *idle;
+    }
+    co_return {};
+}
+
+// only a connection nobody else holds is settled and closed here, its destructor then has nothing left to send. One
+// still in use may have a command in flight (a streamed fetch doesn't settle), its next command settles it.
+inline auto SqlReaper::run() -> IoTask<void> {
+    while (!mQueue.empty()) {
+        auto mysql = std::move(mQueue.front());
+        mQueue.pop_front();
+        mysql->mRetired = false;
+        if (mysql.use_count() > 1) {
+            continue;
+        }
+        auto ret = co_await mysql->settle();
+        if (!ret) {
+            ILIAS_WARN("sql", "connection teardown failed, {}", ret.error().message());
+        }
+        ret = co_await mysql->disconnect();
+        if (!ret) {
+            ILIAS_WARN("sql", "disconnect failed, {}", ret.error().message());
+        }
+    }
+    auto idle = std::exchange(mIdle, nullptr);
+    idle->set();
+    co_return {};
+}
+
+#undef SQL_PRIVATE_SETTLE
 #undef SQL_PRIVATE_MAKE_POLLER
 #undef SQL_PRIVATE_SYNC_CODE
 #undef MYSQL_OPTION_TABLE
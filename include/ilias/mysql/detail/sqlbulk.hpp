@@ -0,0 +1,270 @@
+/**
+ * @file sqlbulk.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief column wise array binds for batched statement execution
+ * @version 0.1
+ * @date 2025-02-16
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <cstring>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <mariadb/mysql.h>
+
+#include "global.hpp"
+#include "mysql.hpp"
+#include "sqlresultp.hpp"
+
+ILIAS_SQL_NS_BEGIN
+namespace detail {
+
+template <typename T>
+constexpr bool IsSqlText = std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+template <typename T>
+constexpr bool IsSqlBytes = std::is_same_v<T, std::vector<std::byte>> || std::is_same_v<T, std::span<const std::byte>>;
+
+// the mysql type a column of T is sent as, std::optional<T> is T or NULL.
+template <typename T>
+constexpr auto bulkFieldType() -> enum_field_types {
+    if constexpr (IsSqlOptional<T>::value) {
+        return bulkFieldType<typename T::value_type>();
+    }
+    else if constexpr (std::is_integral_v<T>) {
+        static_assert(sizeof(T) <= 8, "unsupported integer size");
+        return sizeof(T) == 1 ? MYSQL_TYPE_TINY
+               : sizeof(T) == 2 ? MYSQL_TYPE_SHORT
+               : sizeof(T) == 4 ? MYSQL_TYPE_LONG
+                                : MYSQL_TYPE_LONGLONG;
+    }
+    else if constexpr (std::is_same_v<T, float>) {
+        return MYSQL_TYPE_FLOAT;
+    }
+    else if constexpr (std::is_same_v<T, double>) {
+        return MYSQL_TYPE_DOUBLE;
+    }
+    else if constexpr (std::is_same_v<T, SqlDate>) {
+        return MYSQL_TYPE_DATETIME;
+    }
+    else if constexpr (IsSqlText<T>) {
+        return MYSQL_TYPE_STRING;
+    }
+    else if constexpr (IsSqlBytes<T>) {
+        return MYSQL_TYPE_BLOB;
+    }
+    else {
+        static_assert(!sizeof(T), "unsupported batch column type");
+    }
+}
+
+/**
+ * @brief Builds column wise MYSQL_BIND arrays from a span of tuples.
+ *
+ * Fixed size values are copied into one contiguous array per column, strings and blobs are only referenced (an array
+ * of pointers plus an array of lengths), so the rows must stay alive until the execute is done. An array bind reads
+ * the types without a fixed packed length (temporal ones) through pointers as well, a SqlDate column keeps its
+ * MYSQL_TIME copies and an array of pointers to them.
+ */
+class SqlBulkBinder {
+public:
+    template <typename Row>
+    auto bind(std::span<const Row> rows) -> void;
+    auto rowCount() const -> std::size_t { return mRows; }
+    auto columnCount() const -> std::size_t { return mColumns.size(); }
+    ///> binds of all rows, for STMT_ATTR_ARRAY_SIZE.
+    auto arrayBinds() -> MYSQL_BIND *;
+    ///> binds of a single row, for servers without bulk support.
+    auto rowBinds(std::size_t row) -> MYSQL_BIND *;
+
+private:
+    struct Column {
+        enum_field_types           type        = MYSQL_TYPE_NULL;
+        bool                       isUnsigned  = false;
+        bool                       isVariable  = false;
+        bool                       isTemporal  = false;
+        std::size_t                elementSize = 0;
+        std::vector<std::byte>     values;     // fixed size values
+        std::vector<char *>        pointers;   // variable length values, the values of a temporal column
+        std::vector<unsigned long> lengths;    // variable length values
+        std::vector<char>          indicators; // STMT_INDICATOR_NONE / STMT_INDICATOR_NULL, also usable as my_bool
+    };
+
+    template <typename T>
+    auto setup(Column &column, std::size_t rows) -> void;
+    template <typename T>
+    auto append(Column &column, const T &value) -> void;
+    auto fill(MYSQL_BIND &bind, Column &column, std::size_t row, bool array) -> void;
+
+    std::size_t             mRows = 0;
+    std::vector<Column>     mColumns;
+    std::vector<MYSQL_BIND> mBinds;
+};
+
+template <typename T>
+inline auto SqlBulkBinder::setup(Column &column, std::size_t rows) -> void {
+    using Value       = typename IsSqlOptional<T>::ValueType;
+    column.type       = bulkFieldType<T>();
+    column.isVariable = IsSqlText<Value> || IsSqlBytes<Value>;
+    column.isTemporal = std::is_same_v<Value, SqlDate>;
+    if constexpr (std::is_integral_v<Value>) {
+        column.isUnsigned = std::is_unsigned_v<Value>;
+    }
+    if (column.isVariable || column.isTemporal) {
+        column.pointers.reserve(rows);
+    }
+    if (column.isVariable) {
+        column.lengths.reserve(rows);
+    }
+    else {
+        column.elementSize = std::is_same_v<Value, SqlDate> ? sizeof(MYSQL_TIME) : sizeof(Value);
+        column.values.reserve(rows * column.elementSize);
+    }
+    column.indicators.reserve(rows);
+}
+
+template <typename T>
+inline auto SqlBulkBinder::append(Column &column, const T &value) -> void {
+    if constexpr (IsSqlOptional<T>::value) {
+        if (value) {
+            append(column, *value);
+        }
+        else {
+            append(column, typename T::value_type {});
+            column.indicators.back() = STMT_INDICATOR_NULL;
+        }
+        return;
+    }
+    else if constexpr (IsSqlText<T> || IsSqlBytes<T>) {
+        column.pointers.push_back(reinterpret_cast<char *>(const_cast<std::remove_cvref_t<decltype(*value.data())> *>(
+            value.data())));
+        column.lengths.push_back((unsigned long)value.size());
+    }
+    else if constexpr (std::is_same_v<T, SqlDate>) {
+        auto offset = column.values.size();
+        column.values.resize(offset + sizeof(MYSQL_TIME));
+        memcpy(column.values.data() + offset, &value.time, sizeof(MYSQL_TIME));
+    }
+    else {
+        auto offset = column.values.size();
+        column.values.resize(offset + sizeof(T));
+        memcpy(column.values.data() + offset, &value, sizeof(T));
+    }
+    column.indicators.push_back(STMT_INDICATOR_NONE);
+}
+
+template <typename Row>
+inline auto SqlBulkBinder::bind(std::span<const Row> rows) -> void {
+    constexpr auto kColumns = std::tuple_size_v<Row>;
+    mRows                   = rows.size();
+    mColumns.clear();
+    mColumns.resize(kColumns);
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        (setup<std::remove_cvref_t<std::tuple_element_t<I, Row>>>(mColumns[I], rows.size()), ...);
+        for (auto &row : rows) {
+            (append(mColumns[I], std::get<I>(row)), ...);
+        }
+    }(std::make_index_sequence<kColumns> {});
+    // the values are all in place, they don't move anymore.
+    for (auto &column : mColumns) {
+        if (!column.isTemporal) {
+            continue;
+        }
+        for (std::size_t row = 0; row < mRows; ++row) {
+            column.pointers.push_back(reinterpret_cast<char *>(column.values.data() + row * column.elementSize));
+        }
+    }
+    mBinds.resize(kColumns);
+}
+
+inline auto SqlBulkBinder::fill(MYSQL_BIND &bind, Column &column, std::size_t row, bool array) -> void {
+    memset(&bind, 0, sizeof(bind));
+    bind.buffer_type = column.type;
+    bind.is_unsigned = column.isUnsigned;
+    if (array) {
+        // column wise: buffer is an array of values (or of pointers for variable length and temporal columns).
+        bind.buffer      = column.pointers.empty() ? (void *)column.values.data() : (void *)column.pointers.data();
+        bind.length      = column.isVariable ? column.lengths.data() : nullptr;
+        bind.u.indicator = column.indicators.data();
+        return;
+    }
+    if (column.isVariable) {
+        bind.buffer        = column.pointers[row];
+        bind.buffer_length = column.lengths[row];
+        bind.length        = &column.lengths[row];
+    }
+    else {
+        bind.buffer = column.values.data() + row * column.elementSize;
+    }
+    bind.is_null = reinterpret_cast<my_bool *>(&column.indicators[row]);
+}
+
+inline auto SqlBulkBinder::arrayBinds() -> MYSQL_BIND * {
+    for (std::size_t i = 0; i < mColumns.size(); ++i) {
+        fill(mBinds[i], mColumns[i], 0, true);
+    }
+    return mBinds.data();
+}
+
+inline auto SqlBulkBinder::rowBinds(std::size_t row) -> MYSQL_BIND * {
+    for (std::size_t i = 0; i < mColumns.size(); ++i) {
+        fill(mBinds[i], mColumns[i], row, false);
+    }
+    return mBinds.data();
+}
+
+// run a prepared statement once per bound row, in a single COM_STMT_BULK_EXECUTE when the server supports it.
+// return the sum of affected rows.
+inline auto executeBulk(MySql &mysql, MYSQL_STMT *stmt, SqlBulkBinder &binder) -> IoTask<uint64_t> {
+    if (binder.columnCount() != mysql_stmt_param_count(stmt)) {
+        ILIAS_ERROR("sql", "batch has {} columns, statement has {} parameters", binder.columnCount(),
+                    mysql_stmt_param_count(stmt));
+        co_return Unexpected<Error>(SqlError::INVALID_PARAMETER);
+    }
+    if (binder.rowCount() == 0) {
+        co_return 0;
+    }
+    if (mysql.supportsBulk()) {
+        unsigned int arraySize = (unsigned int)binder.rowCount();
+        mysql_stmt_attr_set(stmt, STMT_ATTR_ARRAY_SIZE, &arraySize);
+        if (mysql_stmt_bind_param(stmt, binder.arrayBinds()) != 0) {
+            ILIAS_ERROR("sql", "stmt bind failed. (error {}:{})", mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+            arraySize = 0;
+            mysql_stmt_attr_set(stmt, STMT_ATTR_ARRAY_SIZE, &arraySize);
+            co_return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(stmt));
+        }
+        auto ret = co_await mysql.stmtExecute(stmt);
+        // back to single row executes for the next user of the statement.
+        arraySize = 0;
+        mysql_stmt_attr_set(stmt, STMT_ATTR_ARRAY_SIZE, &arraySize);
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+        co_return mysql_stmt_affected_rows(stmt);
+    }
+    // no bulk support (mysql or mariadb before 10.2), still no re-prepare between the rows.
+    uint64_t affected = 0;
+    for (std::size_t row = 0; row < binder.rowCount(); ++row) {
+        if (mysql_stmt_bind_param(stmt, binder.rowBinds(row)) != 0) {
+            ILIAS_ERROR("sql", "stmt bind failed. (error {}:{})", mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+            co_return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(stmt));
+        }
+        auto ret = co_await mysql.stmtExecute(stmt);
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+        affected += mysql_stmt_affected_rows(stmt);
+    }
+    co_return affected;
+}
+
+} // namespace detail
+ILIAS_SQL_NS_END
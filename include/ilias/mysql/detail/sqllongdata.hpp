@@ -0,0 +1,109 @@
+/**
+ * @file sqllongdata.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief statement parameters sent in chunks before execute
+ * @version 0.1
+ * @date 2025-03-01
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+#include <mariadb/mysql.h>
+
+#include "global.hpp"
+#include "mysql.hpp"
+
+ILIAS_SQL_NS_BEGIN
+
+/**
+ * @brief The next chunk of a streamed parameter, an empty chunk ends the stream. A chunk only has to stay valid until
+ * the source is called again, so one buffer can be refilled for the whole stream.
+ */
+using SqlChunkSource = std::function<IoTask<std::span<const std::byte>>()>;
+
+///> a source of the chunkSize slices of data (a mmap'd file...), data has to stay valid during execute.
+inline auto chunksOf(std::span<const std::byte> data, size_t chunkSize = 1024 * 1024) -> SqlChunkSource {
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    return [data, chunkSize]() mutable -> IoTask<std::span<const std::byte>> {
+        auto chunk = data.first(std::min(chunkSize, data.size()));
+        data       = data.subspan(chunk.size());
+        co_return chunk;
+    };
+}
+
+namespace detail {
+
+// parameters whose value is sent with mysql_stmt_send_long_data, bound as a BLOB without buffer.
+class SqlLongData {
+public:
+    auto empty() const -> bool { return mStreams.empty(); }
+    auto add(int index, SqlChunkSource source) -> void;
+    auto clear() -> void { mStreams.clear(); }
+    ///> after the params are bound and before execute, the streams are cleared.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto send(MySql &mysql, MYSQL_STMT *stmt) -> IoTask<void>;
+
+private:
+    [[nodiscard("Don't forget to use co_await")]]
+    static auto stream(MySql &mysql, MYSQL_STMT *stmt, int index, SqlChunkSource &source) -> IoTask<void>;
+
+    std::vector<std::pair<int, SqlChunkSource>> mStreams;
+};
+
+inline auto SqlLongData::add(int index, SqlChunkSource source) -> void {
+    auto iter = std::find_if(mStreams.begin(), mStreams.end(), [&](auto &stream) { return stream.first == index; });
+    if (iter != mStreams.end()) {
+        iter->second = std::move(source);
+        return;
+    }
+    mStreams.emplace_back(index, std::move(source));
+}
+
+// the server joins the chunks of a parameter until the execute. After a failed stream the statement is reset, the
+// next execute would send the chunks that made it otherwise.
+inline auto SqlLongData::send(MySql &mysql, MYSQL_STMT *stmt) -> IoTask<void> {
+    auto streams = std::move(mStreams);
+    mStreams.clear();
+    for (auto &[index, source] : streams) {
+        auto ret = co_await stream(mysql, stmt, index, source);
+        if (!ret) {
+            if (auto reset = co_await mysql.stmtReset(stmt); !reset) {
+                ILIAS_WARN("sql", "stmt reset after a failed stream failed, {}", reset.error().message());
+            }
+            co_return Unexpected<Error>(ret.error());
+        }
+    }
+    co_return {};
+}
+
+inline auto SqlLongData::stream(MySql &mysql, MYSQL_STMT *stmt, int index, SqlChunkSource &source) -> IoTask<void> {
+    size_t total = 0;
+    while (true) {
+        auto chunk = co_await source();
+        if (!chunk) {
+            co_return Unexpected<Error>(chunk.error());
+        }
+        if (chunk->empty()) {
+            break;
+        }
+        auto ret = co_await mysql.stmtSendLongData(stmt, (unsigned int)index, chunk.value());
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+        total += chunk->size();
+    }
+    ILIAS_TRACE("sql", "stmt param {} streamed {} bytes", index, total);
+    co_return {};
+}
+
+} // namespace detail
+
+ILIAS_SQL_NS_END
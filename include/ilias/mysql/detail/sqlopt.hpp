@@ -79,6 +79,8 @@ public:
 template <mysql_option Optname, typename T, class enable = void>
 class OptionT : public OptionBase {
 public:
+    static constexpr mysql_option option = Optname;
+
     constexpr OptionT() = default;
     constexpr OptionT(T value) : mValue(value) {}
     auto setopt(MYSQL &sql) const -> int override {
@@ -120,6 +122,8 @@ private:
 template <mysql_option Optname, typename T>
 class OptionT<Optname, T *, void> : public OptionBase {
 public:
+    static constexpr mysql_option option = Optname;
+
     constexpr OptionT() = default;
     constexpr OptionT(T value) : mValue(value) {}
     auto setopt(MYSQL &sql) const -> int override {
@@ -162,6 +166,8 @@ private:
 template <mysql_option Optname>
 class OptionT<Optname, std::string, void> : public OptionBase {
 public:
+    static constexpr mysql_option option = Optname;
+
     constexpr OptionT() = default;
     constexpr OptionT(const std::string &value) : mValue(value) {}
     auto setopt(MYSQL &sql) const -> int override {
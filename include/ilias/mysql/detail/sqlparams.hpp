@@ -0,0 +1,52 @@
+/**
+ * @file sqlparams.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief named parameter rewriting shared by SqlQuery and SqlPreparedStatement
+ * @version 0.1
+ * @date 2025-02-14
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "global.hpp"
+
+ILIAS_SQL_NS_BEGIN
+namespace detail {
+
+// this query should like "SELECT * FROM table WHERE name=:name,age=:age;"
+// return query like "SELECT * FROM table WHERE name=?,age=?;", indexs get {name: 0, age: 1}
+inline auto rewriteNamedParams(std::string_view query, std::unordered_map<std::string, int> &indexs) -> std::string {
+    indexs.clear();
+    std::string ret;
+    auto        start = query.find_first_of(':');
+    if (start != std::string::npos) {
+        ret = query.substr(0, start);
+    }
+    else {
+        return std::string(query);
+    }
+    auto end = start;
+    while (start != std::string::npos) {
+        end = start;
+        while (end < query.size() && query[end] != ' ' && query[end] != ',' && query[end] != '\t' &&
+               query[end] != '\n' && query[end] != '\r' && query[end] != ')' && query[end] != '(' &&
+               query[end] != '"') {
+            end++;
+        }
+        auto name = query.substr(start + 1, end - start - 1);
+        indexs.emplace(name, indexs.size());
+        ret += '?';
+        start = query.find_first_of(':', end);
+        ret += query.substr(end, start - end);
+    }
+    return ret;
+}
+
+} // namespace detail
+ILIAS_SQL_NS_END
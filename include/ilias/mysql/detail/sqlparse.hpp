@@ -0,0 +1,171 @@
+/**
+ * @file sqlparse.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief allocation free parsers for text protocol values
+ * @version 0.1
+ * @date 2025-02-22
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <mariadb/mysql.h>
+
+#include "global.hpp"
+
+ILIAS_SQL_NS_BEGIN
+namespace detail {
+
+// true if the 8 bytes at p are all ascii digits.
+inline auto isEightDigits(const char *p) -> bool {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return ((value & 0xF0F0F0F0F0F0F0F0) | (((value + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+           0x3333333333333333;
+}
+
+// the number of 8 ascii digits at p, the first digit is the most significant one (little endian load).
+inline auto parseEightDigits(const char *p) -> uint32_t {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    value = ((value & 0x0F0F0F0F0F0F0F0F) * 2561) >> 8;
+    value = ((value & 0x00FF00FF00FF00FF) * 6553601) >> 16;
+    return static_cast<uint32_t>(((value & 0x0000FFFF0000FFFF) * 42949672960001) >> 32);
+}
+
+// a decimal integer as the server sends it, optional '-' then digits (ZEROFILL leading zeros included).
+template <typename T>
+inline auto parseInteger(std::string_view text, T &out) -> bool {
+    static_assert(std::is_integral_v<T>, "parseInteger needs an integer type");
+    auto p        = text.data();
+    auto end      = p + text.size();
+    bool negative = p != end && *p == '-';
+    if (negative) {
+        ++p;
+    }
+    while (end - p > 1 && *p == '0') {
+        ++p;
+    }
+    if (p == end || end - p > 20) {
+        return false;
+    }
+    uint64_t value = 0;
+    if constexpr (std::endian::native == std::endian::little) {
+        // at most two chunks fit before the checked tail, 20 digits is the most a uint64_t takes.
+        while (end - p >= 8 && isEightDigits(p)) {
+            value = value * 100000000 + parseEightDigits(p);
+            p += 8;
+        }
+    }
+    for (; p != end; ++p) {
+        unsigned int digit = static_cast<unsigned char>(*p) - '0';
+        if (digit > 9 || value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    if constexpr (std::is_unsigned_v<T>) {
+        if ((negative && value != 0) || value > std::numeric_limits<T>::max()) {
+            return false;
+        }
+        out = static_cast<T>(value);
+    }
+    else {
+        uint64_t limit = static_cast<uint64_t>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+        if (value > limit) {
+            return false;
+        }
+        out = negative ? static_cast<T>(0 - value) : static_cast<T>(value);
+    }
+    return true;
+}
+
+inline auto parseFixedDigits(const char *p, std::ptrdiff_t count, unsigned int &out) -> bool {
+    unsigned int value = 0;
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+        unsigned int digit = static_cast<unsigned char>(p[i]) - '0';
+        if (digit > 9) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    out = value;
+    return true;
+}
+
+// "mm:ss" with an optional ".f" to ".ffffff" fraction, the fraction is scaled to microseconds.
+inline auto parseMinuteSecond(const char *p, const char *end, MYSQL_TIME &time) -> bool {
+    if (end - p < 5 || p[2] != ':' || !parseFixedDigits(p, 2, time.minute) ||
+        !parseFixedDigits(p + 3, 2, time.second)) {
+        return false;
+    }
+    p += 5;
+    if (p == end) {
+        return true;
+    }
+    auto digits = end - p - 1;
+    if (*p != '.' || digits < 1 || digits > 6) {
+        return false;
+    }
+    unsigned int fraction = 0;
+    if (!parseFixedDigits(p + 1, digits, fraction)) {
+        return false;
+    }
+    for (; digits < 6; ++digits) {
+        fraction *= 10;
+    }
+    time.second_part = fraction;
+    return true;
+}
+
+/**
+ * @brief Parse a temporal text protocol value into a MYSQL_TIME.
+ *
+ * The formats are the ones the server sends: "YYYY-MM-DD" for DATE, "YYYY-MM-DD hh:mm:ss[.ffffff]" for DATETIME and
+ * TIMESTAMP, "[-]hhh:mm:ss[.ffffff]" for TIME.
+ */
+inline auto parseTemporal(std::string_view text, enum_field_types type, MYSQL_TIME &time) -> bool {
+    memset(&time, 0, sizeof(time));
+    auto p   = text.data();
+    auto end = p + text.size();
+    if (type == MYSQL_TYPE_TIME) {
+        time.time_type = MYSQL_TIMESTAMP_TIME;
+        if (p != end && *p == '-') {
+            time.neg = 1;
+            ++p;
+        }
+        auto colon = std::find(p, end, ':');
+        if (colon == end || colon - p < 1 || colon - p > 3 || !parseFixedDigits(p, colon - p, time.hour)) {
+            return false;
+        }
+        return parseMinuteSecond(colon + 1, end, time);
+    }
+    if (end - p < 10 || p[4] != '-' || p[7] != '-' || !parseFixedDigits(p, 4, time.year) ||
+        !parseFixedDigits(p + 5, 2, time.month) || !parseFixedDigits(p + 8, 2, time.day)) {
+        return false;
+    }
+    p += 10;
+    if (type == MYSQL_TYPE_DATE || type == MYSQL_TYPE_NEWDATE) {
+        time.time_type = MYSQL_TIMESTAMP_DATE;
+        return p == end;
+    }
+    time.time_type = MYSQL_TIMESTAMP_DATETIME;
+    if (p == end) {
+        return true;
+    }
+    if ((*p != ' ' && *p != 'T') || end - p < 4 || p[3] != ':' || !parseFixedDigits(p + 1, 2, time.hour)) {
+        return false;
+    }
+    return parseMinuteSecond(p + 4, end, time);
+}
+
+} // namespace detail
+ILIAS_SQL_NS_END
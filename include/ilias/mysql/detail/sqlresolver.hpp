@@ -0,0 +1,168 @@
+/**
+ * @file sqlresolver.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief host names resolved on the IoContext for MySql::connect
+ * @version 0.1
+ * @date 2025-03-03
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <ilias/net/addrinfo.hpp>
+#include <ilias/sync/event.hpp>
+#include <ilias/task/decorator.hpp>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "global.hpp"
+
+ILIAS_SQL_NS_BEGIN
+namespace detail {
+
+/**
+ * @brief The addresses of the hosts connected to from one IoContext (one per thread), so the connector gets a literal
+ * address and never calls its blocking getaddrinfo on the event loop.
+ *
+ * The addresses are kept for the ttl and the connects to a host during a lookup share it. Every resolve starts at the
+ * next address of the host, the connections of a pool are spread over all of them.
+ */
+class SqlResolver {
+public:
+    using Lookup = std::function<IoTask<std::vector<std::string>>(std::string)>;
+
+    static auto current() -> SqlResolver &;
+    ///> a host the connector doesn't look up: empty, localhost (the unix socket) or already an address.
+    static auto isLiteral(std::string_view host) -> bool;
+
+    ///> 0 looks the host up on every connect.
+    auto setTtl(std::chrono::milliseconds ttl) -> void { mTtl = ttl; }
+    auto ttl() const -> std::chrono::milliseconds { return mTtl; }
+    ///> how a host is looked up, AddressInfo::fromHostnameAsync by default.
+    auto setLookup(Lookup lookup) -> void { mLookup = std::move(lookup); }
+    ///> drop the addresses of host, of every host when it is empty.
+    auto forget(std::string_view host = {}) -> void;
+    ///> the addresses of host, rotated by one on each call.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto resolve(std::string_view host) -> IoTask<std::vector<std::string>>;
+
+private:
+    struct Entry {
+        std::vector<std::string>              addresses;
+        std::chrono::steady_clock::time_point expiry;
+        size_t                                next = 0;
+        Error                                 error;  // of the last lookup, when it found nothing
+        std::shared_ptr<Event>                lookup; // set when the running lookup is done
+    };
+
+    [[nodiscard("Don't forget to use co_await")]]
+    auto lookup(const std::string &host) -> IoTask<std::vector<std::string>>;
+    [[nodiscard("Don't forget to use co_await")]]
+    static auto query(std::string host) -> IoTask<std::vector<std::string>>;
+    static auto rotate(Entry &entry) -> std::vector<std::string>;
+
+    std::chrono::milliseconds              mTtl = std::chrono::seconds(30);
+    std::unordered_map<std::string, Entry> mEntries;
+    Lookup                                 mLookup;
+};
+
+inline auto SqlResolver::current() -> SqlResolver & {
+    static thread_local SqlResolver resolver;
+    return resolver;
+}
+
+inline auto SqlResolver::isLiteral(std::string_view host) -> bool {
+    if (host.empty() || host == "localhost" || host.find(':') != std::string_view::npos) {
+        return true;
+    }
+    return std::all_of(host.begin(), host.end(), [](char c) { return c == '.' || (c >= '0' && c <= '9'); });
+}
+
+inline auto SqlResolver::forget(std::string_view host) -> void {
+    if (host.empty()) {
+        std::erase_if(mEntries, [](auto &item) { return item.second.lookup == nullptr; });
+        return;
+    }
+    auto iter = mEntries.find(std::string(host));
+    if (iter != mEntries.end() && iter->second.lookup == nullptr) {
+        iter->second.addresses.clear();
+    }
+}
+
+inline auto SqlResolver::rotate(Entry &entry) -> std::vector<std::string> {
+    auto addresses = entry.addresses;
+    std::rotate(addresses.begin(), addresses.begin() + entry.next % addresses.size(), addresses.end());
+    entry.next = (entry.next + 1) % addresses.size();
+    return addresses;
+}
+
+inline auto SqlResolver::resolve(std::string_view host) -> IoTask<std::vector<std::string>> {
+    auto key  = std::string(host);
+    auto iter = mEntries.find(key);
+    if (iter != mEntries.end() && iter->second.lookup != nullptr) {
+        // a reconnect storm makes one lookup, the others wait for its answer.
+        auto lookup = iter->second.lookup;
+        co_await *lookup;
+        iter = mEntries.find(key);
+        if (iter != mEntries.end() && iter->second.lookup == nullptr) {
+            if (iter->second.addresses.empty()) {
+                co_return Unexpected<Error>(iter->second.error);
+            }
+            co_return rotate(iter->second);
+        }
+    }
+    if (iter != mEntries.end() && !iter->second.addresses.empty() &&
+        std::chrono::steady_clock::now() < iter->second.expiry) {
+        co_return rotate(iter->second);
+    }
+    co_return co_await lookup(key);
+}
+
+// the entry is found again after the lookup, forget() may drop it meanwhile. The waiters are woken last, they may
+// change the entry.
+inline auto SqlResolver::lookup(const std::string &host) -> IoTask<std::vector<std::string>> {
+    auto event            = std::make_shared<Event>();
+    mEntries[host].lookup = event;
+    auto found            = co_await ((mLookup ? mLookup(host) : query(host)) | ignoreCancellation);
+    auto &entry           = mEntries[host];
+    entry.lookup          = nullptr;
+    entry.addresses       = found ? std::move(found.value()) : std::vector<std::string> {};
+    entry.error           = found ? Error(Error::Unknown) : found.error();
+    entry.expiry          = std::chrono::steady_clock::now() + mTtl;
+    if (entry.addresses.empty()) {
+        ILIAS_WARN("sql", "resolve host {} failed, {}", host, entry.error.message());
+        auto error = entry.error;
+        event->set();
+        co_return Unexpected<Error>(error);
+    }
+    ILIAS_TRACE("sql", "host {} resolved to {} addresses", host, entry.addresses.size());
+    auto addresses = rotate(entry);
+    event->set();
+    co_return addresses;
+}
+
+inline auto SqlResolver::query(std::string host) -> IoTask<std::vector<std::string>> {
+    auto info = co_await AddressInfo::fromHostnameAsync(host.c_str());
+    if (!info) {
+        co_return Unexpected<Error>(info.error());
+    }
+    std::vector<std::string> addresses;
+    for (auto &endpoint : info->endpoints()) {
+        // one address comes once per socket type.
+        auto address = endpoint.address().toString();
+        if (std::find(addresses.begin(), addresses.end(), address) == addresses.end()) {
+            addresses.push_back(std::move(address));
+        }
+    }
+    co_return addresses;
+}
+
+} // namespace detail
+ILIAS_SQL_NS_END
@@ -1,19 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <span>
 #include <unordered_map>
 #include <variant>
 #include <iomanip>
 #include <charconv>
 #include <chrono>
+#include <optional>
+#include <string_view>
 #include <mariadb/mysql.h>
 #include <mariadb/mysqld_error.h>
 
 #include "global.hpp"
 #include "mysql.hpp"
+#include "sqlparse.hpp"
 
 ILIAS_SQL_NS_BEGIN
 
 class SqlQuery;
+class SqlPipeline;
+class SqlMultiResult;
+class SqlPreparedStatement;
 
 struct SqlDate {
     inline SqlDate(int year = 0, int month = 0, int day = 0, int hour = 0, int minute = 0, int second = 0) {
@@ -46,12 +55,227 @@ struct SqlDate {
     MYSQL_TIME time = {};
 };
 
+/**
+ * @brief How the rows of a result set get to the client.
+ *
+ * A streamed result keeps the connection busy until it is read to the end or destroyed, no other command can be sent
+ * on the connection in between.
+ */
+enum class SqlResultMode {
+    ///> read the whole result set when executing, countRows() is exact.
+    Buffered,
+    ///> rows are read from the connection by next(), memory stays at one row.
+    Streaming,
+    ///> prepared statements only, a read only server side cursor fetched in chunks of rows, text queries stream.
+    Cursor,
+};
+
 namespace detail {
 
+// bound slot of a string column whose longest value is unknown, grown when a longer value comes.
+constexpr unsigned long kSqlInlineSlotLength = 256;
+// upper bound of a slot sized from the result metadata, longer values are read by mysql_stmt_fetch_column.
+constexpr unsigned long kSqlMaxSlotLength = 64 * 1024;
+// rows per COM_STMT_FETCH of a cursor.
+constexpr unsigned long kSqlCursorPrefetchRows = 256;
+
+template <typename T>
+struct IsSqlOptional : std::false_type {
+    using ValueType = T;
+};
+template <typename T>
+struct IsSqlOptional<std::optional<T>> : std::true_type {
+    using ValueType = T;
+};
+
+// one value of the current row as the protocol delivered it, before any conversion.
+struct SqlCell {
+    enum Kind : uint8_t {
+        Null,
+        Text,    // text protocol value or string bound value
+        Integer, // binary protocol integer, unsigned when isUnsigned
+        Real,    // binary protocol float or double
+    };
+    Kind             kind       = Null;
+    bool             isUnsigned = false;
+    enum_field_types type       = MYSQL_TYPE_NULL; // column type of the result metadata
+    std::string_view text;
+    int64_t          integer = 0;
+    double           real    = 0;
+};
+
+// the end of a result is reported as an error by next(), OK by the text protocol and MYSQL_NO_DATA by statements.
+inline auto isEndOfRows(const Error &error) -> bool {
+    return error == SqlError::Code::OK || error == SqlError::Code::NO_MORE_DATA ||
+           error == (SqlError::Code)MYSQL_NO_DATA;
+}
+
+// text protocol temporal value, the format follows the column type.
+inline auto parseSqlDate(std::string_view text, enum_field_types type) -> SqlDate {
+    SqlDate date;
+    if (!parseTemporal(text, type, date.time)) {
+        ILIAS_WARN("sql", "unexpected temporal value {}", text);
+        date.time.time_type = MYSQL_TIMESTAMP_ERROR;
+    }
+    return date;
+}
+
+// the first bound slot size of a string column, a buffered result knows its longest value (max_length).
+inline auto boundSlotLength(const MYSQL_FIELD &field, bool buffered) -> unsigned long {
+    if (buffered && field.max_length > 0) {
+        return std::min(field.max_length, kSqlMaxSlotLength);
+    }
+    return std::min(field.length, kSqlInlineSlotLength);
+}
+
+// cursor attributes have to be set before the statement is executed, cached statements are set back to no cursor.
+inline auto applyResultMode(MYSQL_STMT *stmt, SqlResultMode mode) -> void {
+    unsigned long cursor = mode == SqlResultMode::Cursor ? CURSOR_TYPE_READ_ONLY : CURSOR_TYPE_NO_CURSOR;
+    mysql_stmt_attr_set(stmt, STMT_ATTR_CURSOR_TYPE, &cursor);
+    if (mode == SqlResultMode::Cursor) {
+        unsigned long prefetch = kSqlCursorPrefetchRows;
+        mysql_stmt_attr_set(stmt, STMT_ATTR_PREFETCH_ROWS, &prefetch);
+    }
+}
+
 using SqlArrayBuffer = std::vector<std::byte>;
 using SqlResultType =
     std::variant<nullptr_t, char, int32_t, int64_t, double, float, std::string, SqlDate, SqlArrayBuffer>;
 
+// decodes one non NULL value, chosen once per column when the result metadata arrives.
+using SqlDecoder = auto (*)(const char *data, unsigned long length) -> Result<SqlResultType>;
+
+// unsigned columns are parsed as unsigned and stored in the signed type of the same width.
+template <typename T, typename Parse = T>
+inline auto decodeText(const char *data, unsigned long length) -> Result<SqlResultType> {
+    Parse value;
+    if constexpr (std::is_integral_v<Parse>) {
+        if (!parseInteger(std::string_view(data, length), value)) {
+            return Unexpected<Error>(SqlError::UNKNOWN_ERROR);
+        }
+    }
+    else {
+        auto [ptr, ec] = std::from_chars(data, data + length, value);
+        if (ec != std::errc() || ptr != data + length) {
+            return Unexpected<Error>(SqlError::UNKNOWN_ERROR);
+        }
+    }
+    return SqlResultType(std::in_place_type<T>, static_cast<T>(value));
+}
+
+// bound integers are int64_t, bound floating points are double.
+template <typename T, typename Bound>
+inline auto decodeBinary(const char *data, unsigned long) -> Result<SqlResultType> {
+    Bound value;
+    memcpy(&value, data, sizeof(value));
+    return SqlResultType(std::in_place_type<T>, static_cast<T>(value));
+}
+
+template <enum_field_types Type>
+inline auto decodeDate(const char *data, unsigned long length) -> Result<SqlResultType> {
+    return SqlResultType(std::in_place_type<SqlDate>, parseSqlDate(std::string_view(data, length), Type));
+}
+
+inline auto decodeString(const char *data, unsigned long length) -> Result<SqlResultType> {
+    return SqlResultType(std::in_place_type<std::string>, data, length);
+}
+
+inline auto decodeBlob(const char *data, unsigned long length) -> Result<SqlResultType> {
+    auto bytes = reinterpret_cast<const std::byte *>(data);
+    return SqlResultType(std::in_place_type<SqlArrayBuffer>, bytes, bytes + length);
+}
+
+inline auto decodeNull(const char *, unsigned long) -> Result<SqlResultType> {
+    return SqlResultType(nullptr);
+}
+
+inline auto decodeUnknown(const char *, unsigned long) -> Result<SqlResultType> {
+    return Unexpected<Error>(SqlError::Code::UNKNOWN_ERROR);
+}
+
+// binary: the value is in a SqlStmtResult bound buffer, otherwise it is the text of a MYSQL_ROW.
+inline auto selectDecoder(const MYSQL_FIELD &field, bool binary) -> SqlDecoder {
+    bool isUnsigned = (field.flags & UNSIGNED_FLAG) != 0;
+    switch (field.type) {
+        case MYSQL_TYPE_TINY:
+            if (binary) {
+                return decodeBinary<char, int64_t>;
+            }
+            return isUnsigned ? decodeText<char, uint8_t> : decodeText<char, int8_t>;
+        case MYSQL_TYPE_SHORT:
+        case MYSQL_TYPE_LONG:
+        case MYSQL_TYPE_INT24:
+            if (binary) {
+                return decodeBinary<int32_t, int64_t>;
+            }
+            return isUnsigned ? decodeText<int32_t, uint32_t> : decodeText<int32_t>;
+        case MYSQL_TYPE_YEAR:
+            return binary ? decodeBinary<int32_t, int64_t> : decodeText<int32_t>;
+        case MYSQL_TYPE_LONGLONG:
+            if (binary) {
+                return decodeBinary<int64_t, int64_t>;
+            }
+            return isUnsigned ? decodeText<int64_t, uint64_t> : decodeText<int64_t>;
+        case MYSQL_TYPE_FLOAT:
+            return binary ? decodeBinary<float, double> : decodeText<float>;
+        case MYSQL_TYPE_DOUBLE:
+            return binary ? decodeBinary<double, double> : decodeText<double>;
+        case MYSQL_TYPE_DECIMAL:
+        case MYSQL_TYPE_NEWDECIMAL:
+            // sent as text by both protocols (the statement binds it as a string).
+            return decodeText<double>;
+        case MYSQL_TYPE_NULL:
+            return decodeNull;
+        case MYSQL_TYPE_TIMESTAMP:
+        case MYSQL_TYPE_DATETIME:
+            return decodeDate<MYSQL_TYPE_DATETIME>;
+        case MYSQL_TYPE_DATE:
+        case MYSQL_TYPE_NEWDATE:
+            return decodeDate<MYSQL_TYPE_DATE>;
+        case MYSQL_TYPE_TIME:
+            return decodeDate<MYSQL_TYPE_TIME>;
+        case MYSQL_TYPE_VARCHAR:
+        case MYSQL_TYPE_VAR_STRING:
+        case MYSQL_TYPE_STRING:
+            return decodeString;
+        case MYSQL_TYPE_BLOB:
+        case MYSQL_TYPE_LONG_BLOB:
+        case MYSQL_TYPE_MEDIUM_BLOB:
+        case MYSQL_TYPE_TINY_BLOB:
+            return decodeBlob;
+        default:
+            return decodeUnknown;
+    }
+}
+
+// column name to index, built once per result set. the keys point into the MYSQL_FIELD array of the result.
+class SqlColumnIndex {
+public:
+    auto build(const MYSQL_FIELD *fields, std::size_t count) -> void;
+    auto find(std::string_view name) const -> Result<std::size_t>;
+    auto clear() -> void { mIndex.clear(); }
+
+private:
+    std::unordered_map<std::string_view, std::size_t> mIndex;
+};
+
+inline auto SqlColumnIndex::build(const MYSQL_FIELD *fields, std::size_t count) -> void {
+    mIndex.clear();
+    mIndex.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        // a duplicated name resolves to its first column, like the scan it replaces.
+        mIndex.try_emplace(std::string_view(fields[i].name, fields[i].name_length), i);
+    }
+}
+
+inline auto SqlColumnIndex::find(std::string_view name) const -> Result<std::size_t> {
+    auto it = mIndex.find(name);
+    if (it == mIndex.end()) {
+        return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
+    }
+    return it->second;
+}
+
 class SqlResultBase {
 public:
     SqlResultBase()                            = default;
@@ -65,13 +289,38 @@ public:
     [[nodiscard("Don't forget to use co_await")]]
     virtual auto next() -> IoTask<void>                              = 0;
     virtual auto countRows() -> size_t                               = 0;
+    ///> columns of the current result set.
+    virtual auto columnCount() -> size_t                             = 0;
+    ///> metadata of a column of the current result set, nullptr for a bad index.
+    virtual auto field(size_t index) -> const MYSQL_FIELD *          = 0;
     virtual auto get(size_t index) -> Result<SqlResultType>          = 0;
     virtual auto get(std::string_view name) -> Result<SqlResultType> = 0;
+    ///> the column bytes in the row buffer, valid until the next next(). NULL is an empty view with a null data().
+    virtual auto view(size_t index) -> Result<std::string_view>          = 0;
+    virtual auto view(std::string_view name) -> Result<std::string_view> = 0;
+    ///> index of a column of the current result set.
+    virtual auto indexOf(std::string_view name) -> Result<size_t> = 0;
+    ///> the value as received, for decoding without SqlResultType.
+    virtual auto cell(size_t index) -> Result<SqlCell> = 0;
+    ///> move to the next row without suspending when it is already in memory, false when next() has to be used.
+    virtual auto nextLocal() -> Result<bool> { return false; }
+    ///> copy the column bytes from offset into buffer, returns the bytes copied: 0 past the end or for a NULL.
+    virtual auto readColumn(size_t index, size_t offset, std::span<std::byte> buffer) -> Result<size_t>;
+    ///> the rows of the current result set keep no more of the column than its first slot, it is read by
+    ///> readColumn(). a text protocol row is always whole, nothing to do.
+    virtual auto deferColumn(size_t index) -> Result<void> { return {}; }
+    ///> changes whenever a new result set (new columns) is loaded.
+    auto generation() const -> size_t { return mGeneration; }
+
+protected:
+    size_t mGeneration = 0;
 };
 
 class SqlQueryResult final : public SqlResultBase {
 public:
-    SqlQueryResult(std::shared_ptr<detail::MySql> sql);
+    ///> singleSet: the rows end with the current result set, the next one is left to the caller.
+    SqlQueryResult(std::shared_ptr<detail::MySql> sql, SqlResultMode mode = SqlResultMode::Buffered,
+                   bool singleSet = false);
     SqlQueryResult(SqlQueryResult &&);
     SqlQueryResult &operator=(SqlQueryResult &&);
     ~SqlQueryResult();
@@ -80,27 +329,49 @@ public:
     auto next() -> IoTask<void> override;
     auto get(size_t index) -> Result<SqlResultType> override;
     auto get(std::string_view name) -> Result<SqlResultType> override;
+    auto view(size_t index) -> Result<std::string_view> override;
+    auto view(std::string_view name) -> Result<std::string_view> override;
+    auto indexOf(std::string_view name) -> Result<size_t> override;
+    auto cell(size_t index) -> Result<SqlCell> override;
+    auto nextLocal() -> Result<bool> override;
     auto countRows() -> size_t override;
+    auto columnCount() -> size_t override { return mFieldMetas.size(); }
+    auto field(size_t index) -> const MYSQL_FIELD * override;
 
 protected:
     [[nodiscard("Don't forget to use co_await")]]
     auto getResult() -> IoTask<void>;
     [[nodiscard("Don't forget to use co_await")]]
+    auto loadResult() -> IoTask<void>;
+    [[nodiscard("Don't forget to use co_await")]]
     auto fetchRow() -> IoTask<MYSQL_ROW>;
     auto freeResult() -> void;
+    auto loadFieldMetas() -> void;
+    ///> free the result, unread rows are left to the connection.
+    auto retire() -> void;
 
 private:
     std::shared_ptr<detail::MySql> mMysql;
     MYSQL_RES                     *mResult     = nullptr;
     MYSQL_ROW                      mCurrentRow = nullptr;
+    unsigned long                 *mRowLengths = nullptr; // mysql_fetch_lengths of the current row
     std::vector<MYSQL_FIELD *>     mFieldMetas = {};
+    std::vector<SqlDecoder>        mDecoders;
+    SqlColumnIndex                 mColumns;
+    SqlResultMode                  mMode       = SqlResultMode::Buffered;
+    bool                           mPending    = false; // streamed rows left on the connection.
+    bool                           mSingleSet  = false;
 
     friend class ::ILIAS_SQL_COMPLETE_NAMESPACE::SqlQuery;
+    friend class ::ILIAS_SQL_COMPLETE_NAMESPACE::SqlPipeline;
+    friend class ::ILIAS_SQL_COMPLETE_NAMESPACE::SqlMultiResult;
 };
 
 class SqlStmtResult final : public SqlResultBase {
 public:
-    SqlStmtResult(std::shared_ptr<detail::MySql> sql, MYSQL_STMT *stmt);
+    ///> borrowed: the statement belongs to the caller, only its result is freed on close.
+    SqlStmtResult(std::shared_ptr<detail::MySql> sql, MYSQL_STMT *stmt, bool borrowed = false,
+                  SqlResultMode mode = SqlResultMode::Buffered);
     SqlStmtResult(SqlStmtResult &&);
     SqlStmtResult &operator=(SqlStmtResult &&);
     ~SqlStmtResult();
@@ -109,225 +380,285 @@ public:
     auto next() -> IoTask<void> override;
     auto get(size_t index) -> Result<SqlResultType> override;
     auto get(std::string_view name) -> Result<SqlResultType> override;
+    auto view(size_t index) -> Result<std::string_view> override;
+    auto view(std::string_view name) -> Result<std::string_view> override;
+    auto indexOf(std::string_view name) -> Result<size_t> override;
+    auto cell(size_t index) -> Result<SqlCell> override;
+    auto nextLocal() -> Result<bool> override;
+    auto readColumn(size_t index, size_t offset, std::span<std::byte> buffer) -> Result<size_t> override;
+    auto deferColumn(size_t index) -> Result<void> override;
     auto countRows() -> size_t override;
+    auto columnCount() -> size_t override { return mFieldMetas.size(); }
+    auto field(size_t index) -> const MYSQL_FIELD * override;
 
 protected:
     [[nodiscard("Don't forget to use co_await")]]
     auto getResult() -> IoTask<void>;
     [[nodiscard("Don't forget to use co_await")]]
     auto fetchRow() -> IoTask<void>;
+    auto fetchTruncated() -> Result<void>;
+    ///> a deferred column whose value is longer than its slot, only readColumn() can read it.
+    auto isTruncated(size_t index) const -> bool;
     auto freeResult() -> void;
     [[nodiscard("Don't forget to use co_await")]]
     auto storeResult(MYSQL_RES **res) -> IoTask<void>;
     [[nodiscard("Don't forget to use co_await")]]
     auto nextResult() -> IoTask<void>;
-    [[nodiscard("Don't forget to use co_await")]]
-    auto close() -> IoTask<void>;
-    [[nodiscard("Don't forget to use co_await")]]
-    auto reset() -> IoTask<void>;
+    ///> give the statement back, a reset for unread rows or an open cursor is left to the connection.
+    auto retire() -> void;
 
 private:
     std::shared_ptr<detail::MySql>                              mMysql;
     MYSQL_STMT                                                 *mStmt       = nullptr;
     MYSQL_RES                                                  *mResult     = nullptr;
     std::vector<MYSQL_FIELD *>                                  mFieldMetas = {};
-    std::unordered_map<std::string, std::unique_ptr<uint8_t[]>> mFields;
+    std::vector<SqlDecoder>                                     mDecoders;
+    SqlColumnIndex                                              mColumns;
+    std::unique_ptr<std::byte[]>                                mArena;    // bound slots of all columns
+    std::vector<std::vector<std::byte>>                         mOverflow; // grown after a truncated value
+    std::vector<bool>                                           mDeferred; // never grown, read by readColumn()
     std::unique_ptr<MYSQL_BIND[]>                               mBinds;
     std::unique_ptr<unsigned long[]>                            mLengths;
+    std::unique_ptr<my_bool[]>                                  mNulls;
+    bool                                                        mBorrowed = false;
+    SqlResultMode                                               mMode     = SqlResultMode::Buffered;
+    bool                                                        mPending  = false; // unread rows or open cursor.
 
     friend class ::ILIAS_SQL_COMPLETE_NAMESPACE::SqlQuery;
+    friend class ::ILIAS_SQL_COMPLETE_NAMESPACE::SqlPreparedStatement;
 };
 
+inline auto SqlResultBase::readColumn(size_t index, size_t offset, std::span<std::byte> buffer) -> Result<size_t> {
+    auto bytes = view(index);
+    if (!bytes) {
+        return Unexpected<Error>(bytes.error());
+    }
+    if (offset >= bytes->size()) {
+        return 0;
+    }
+    auto size = std::min(buffer.size(), bytes->size() - offset);
+    memcpy(buffer.data(), bytes->data() + offset, size);
+    return size;
+}
+
 inline SqlQueryResult::SqlQueryResult(SqlQueryResult &&other) {
     mMysql            = std::move(other.mMysql);
     mResult           = other.mResult;
     mCurrentRow       = other.mCurrentRow;
+    mRowLengths       = other.mRowLengths;
     mFieldMetas       = std::move(other.mFieldMetas);
+    mDecoders         = std::move(other.mDecoders);
+    mColumns          = std::move(other.mColumns);
+    mMode             = other.mMode;
+    mPending          = other.mPending;
+    mSingleSet        = other.mSingleSet;
     other.mResult     = nullptr;
     other.mCurrentRow = nullptr;
+    other.mPending    = false;
     other.mFieldMetas.clear();
 }
 
 inline SqlQueryResult &SqlQueryResult::operator=(SqlQueryResult &&other) {
-    if (mResult) {
-        freeResult();
-    }
     if (this != &other) {
+        retire();
         mMysql            = std::move(other.mMysql);
         mResult           = other.mResult;
         mCurrentRow       = other.mCurrentRow;
+        mRowLengths       = other.mRowLengths;
         mFieldMetas       = std::move(other.mFieldMetas);
+        mDecoders         = std::move(other.mDecoders);
+        mColumns          = std::move(other.mColumns);
+        mMode             = other.mMode;
+        mPending          = other.mPending;
+        mSingleSet        = other.mSingleSet;
         other.mResult     = nullptr;
         other.mCurrentRow = nullptr;
+        other.mPending    = false;
         other.mFieldMetas.clear();
     }
     return *this;
 }
 
-inline SqlQueryResult::SqlQueryResult(std::shared_ptr<detail::MySql> sql) : mMysql(sql) {
+inline SqlQueryResult::SqlQueryResult(std::shared_ptr<detail::MySql> sql, SqlResultMode mode, bool singleSet)
+    : mMysql(sql), mMode(mode), mSingleSet(singleSet) {
 }
 
 inline SqlQueryResult::~SqlQueryResult() {
-    if (mResult) {
-        freeResult();
-    }
+    retire();
 }
 
 inline auto SqlQueryResult::getResult() -> IoTask<void> {
-    auto ret = co_await (mMysql->storeResult(&mResult) | ignoreCancellation);
+    auto ret = co_await loadResult();
     if (!ret && ret.error() != SqlError::Code::OK) {
         co_return Unexpected<Error>(ret.error());
     }
     co_return {};
 }
 
-inline auto SqlQueryResult::next() -> IoTask<void> {
-    if (mResult == nullptr) {
+inline auto SqlQueryResult::loadResult() -> IoTask<void> {
+    if (mMode == SqlResultMode::Buffered) {
         auto ret = co_await (mMysql->storeResult(&mResult) | ignoreCancellation);
         if (!ret) {
             co_return Unexpected<Error>(ret.error());
         }
     }
-    auto retRow = co_await fetchRow();
-    if (retRow) {
-        mCurrentRow = retRow.value();
-    }
     else {
-        co_return Unexpected<Error>(retRow.error());
-    }
-    if (mCurrentRow) {
-        co_return {};
+        auto ret = co_await mMysql->useResult();
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+        mResult = ret.value();
+        if (mResult == nullptr) {
+            // no result set, same as a failed store result.
+            co_return Unexpected<Error>(mMysql->lastError().error());
+        }
+        mPending = true;
     }
-    else {
+    loadFieldMetas();
+    co_return {};
+}
+
+// loops over the result sets in one frame, empty ones of a multi statement query are skipped without recursion.
+inline auto SqlQueryResult::next() -> IoTask<void> {
+    while (true) {
+        if (mResult == nullptr && mSingleSet) {
+            co_return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
+        }
+        if (mResult == nullptr) {
+            auto ret = co_await loadResult();
+            if (!ret) {
+                co_return Unexpected<Error>(ret.error());
+            }
+        }
+        auto retRow = co_await fetchRow();
+        if (!retRow) {
+            mPending = false;
+            co_return Unexpected<Error>(retRow.error());
+        }
+        mCurrentRow = retRow.value();
+        mRowLengths = mCurrentRow ? mysql_fetch_lengths(mResult) : nullptr;
+        if (mCurrentRow) {
+            co_return {};
+        }
+        if (mSingleSet && !mPending) {
+            co_return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
+        }
+        if (mPending) {
+            // a streamed result ends with a null row for both the last row and a broken read.
+            mPending = false;
+            if (auto error = mMysql->lastError(); !error.isOk()) {
+                freeResult();
+                co_return Unexpected<Error>(error.error());
+            }
+        }
+        freeResult();
         auto ret = co_await (mMysql->nextResult() | ignoreCancellation);
         if (!ret) {
             co_return Unexpected<Error>(ret.error());
         }
-        freeResult();
-        co_return co_await next();
     }
 }
 
+inline auto SqlQueryResult::field(size_t index) -> const MYSQL_FIELD * {
+    return index < mFieldMetas.size() ? mFieldMetas[index] : nullptr;
+}
+
+// a stored result has all its rows in memory, the end of a result set is left to next() (it may read the next one).
+inline auto SqlQueryResult::nextLocal() -> Result<bool> {
+    if (mMode != SqlResultMode::Buffered || mResult == nullptr) {
+        return false;
+    }
+    auto row = mysql_fetch_row(mResult);
+    if (row == nullptr) {
+        return false;
+    }
+    mCurrentRow = row;
+    mRowLengths = mysql_fetch_lengths(mResult);
+    return true;
+}
+
 inline auto SqlQueryResult::get(size_t index) -> Result<SqlResultType> {
     if (mCurrentRow == nullptr) {
         return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
     }
-    if (mFieldMetas.empty()) {
-        mFieldMetas.resize(mysql_num_fields(mResult));
-        auto fieldMetas = mysql_fetch_fields(mResult);
-        for (size_t i = 0; i < mFieldMetas.size(); ++i) {
-            mFieldMetas[i] = &fieldMetas[i];
-        }
-    }
-    if (index < 0 || index >= mFieldMetas.size()) {
+    loadFieldMetas();
+    if (index >= mDecoders.size()) {
         return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
     }
-    // ILIAS_TRACE("sql", "index({})({}) raw data {}", index, (int)mFieldMetas[index]->type, mCurrentRow[index]);
-    SqlResultType result;
-    auto          lengths = mysql_fetch_lengths(mResult);
-    switch (mFieldMetas[index]->type) {
-        case MYSQL_TYPE_TINY: { // char
-            int res;
-            auto [ptr, ec] = std::from_chars(mCurrentRow[index], mCurrentRow[index] + lengths[index], res);
-            if (ec != std::errc() || ptr != mCurrentRow[index] + lengths[index]) {
-                return Unexpected<Error>(SqlError::UNKNOWN_ERROR);
-            }
-            result.emplace<char>(res);
-            break;
-        }
-        case MYSQL_TYPE_SHORT: // short
-        case MYSQL_TYPE_LONG:  // int
-        case MYSQL_TYPE_INT24: {
-            int32_t res;
-            auto [ptr, ec] = std::from_chars(mCurrentRow[index], mCurrentRow[index] + lengths[index], res);
-            if (ec != std::errc() || ptr != mCurrentRow[index] + lengths[index]) {
-                return Unexpected<Error>(SqlError::UNKNOWN_ERROR);
-            }
-            result.emplace<int32_t>(res);
-            break;
-        }
-        case MYSQL_TYPE_FLOAT: {
-            float res;
-            auto [ptr, ec] = std::from_chars(mCurrentRow[index], mCurrentRow[index] + lengths[index], res);
-            if (ec != std::errc() || ptr != mCurrentRow[index] + lengths[index]) {
-                return Unexpected<Error>(SqlError::UNKNOWN_ERROR);
-            }
-            result.emplace<float>(res);
-            break;
-        }
-        case MYSQL_TYPE_DOUBLE: {
-            double res;
-            auto [ptr, ec] = std::from_chars(mCurrentRow[index], mCurrentRow[index] + lengths[index], res);
-            if (ec != std::errc() || ptr != mCurrentRow[index] + lengths[index]) {
-                return Unexpected<Error>(SqlError::UNKNOWN_ERROR);
-            }
-            result.emplace<double>(res);
-            break;
-        }
-        case MYSQL_TYPE_NULL:
-            result.emplace<std::nullptr_t>(nullptr);
-            break;
-        case MYSQL_TYPE_TIMESTAMP:
-        case MYSQL_TYPE_DATETIME:
-            result.emplace<SqlDate>(std::string_view(mCurrentRow[index]));
-            std::get<SqlDate>(result).time.time_type = MYSQL_TIMESTAMP_DATETIME;
-            break;
-        case MYSQL_TYPE_DATE:
-            result.emplace<SqlDate>(std::string_view(mCurrentRow[index]));
-            std::get<SqlDate>(result).time.time_type = MYSQL_TIMESTAMP_DATE;
-            break;
-        case MYSQL_TYPE_TIME:
-            result.emplace<SqlDate>(std::string_view(mCurrentRow[index]), "%H:%M:%S");
-            std::get<SqlDate>(result).time.time_type = MYSQL_TIMESTAMP_TIME;
-            break;
-        case MYSQL_TYPE_LONGLONG: // long long
-            result.emplace<int64_t>(std::stoll(std::string(mCurrentRow[index]), nullptr, 10));
-            break;
-        case MYSQL_TYPE_VARCHAR:
-        case MYSQL_TYPE_VAR_STRING:
-        case MYSQL_TYPE_STRING:
-            result.emplace<std::string>(reinterpret_cast<char *>(mCurrentRow[index]), lengths[index]);
-            break;
-        case MYSQL_TYPE_BLOB:
-        case MYSQL_TYPE_LONG_BLOB:
-        case MYSQL_TYPE_MEDIUM_BLOB:
-        case MYSQL_TYPE_TINY_BLOB:
-            result.emplace<std::vector<std::byte>>(
-                std::vector<std::byte> {reinterpret_cast<std::byte *>(mCurrentRow[index]),
-                                        reinterpret_cast<std::byte *>(mCurrentRow[index]) + lengths[index]});
-            break;
-        default:
-            return Unexpected<Error>(SqlError::Code::UNKNOWN_ERROR);
+    if (mCurrentRow[index] == nullptr) {
+        return SqlResultType(nullptr);
     }
-    return result;
+    return mDecoders[index](mCurrentRow[index], mRowLengths[index]);
 }
 
-// TODO: optimize
 inline auto SqlQueryResult::get(std::string_view name) -> Result<SqlResultType> {
-    if (mResult == nullptr || mCurrentRow == nullptr) {
+    auto index = indexOf(name);
+    if (!index) {
+        return Unexpected<Error>(index.error());
+    }
+    return get(index.value());
+}
+
+inline auto SqlQueryResult::view(size_t index) -> Result<std::string_view> {
+    if (mCurrentRow == nullptr) {
+        return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
+    }
+    loadFieldMetas();
+    if (index >= mFieldMetas.size()) {
+        return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
+    }
+    if (mCurrentRow[index] == nullptr) {
+        return std::string_view {};
+    }
+    return std::string_view(mCurrentRow[index], mRowLengths[index]);
+}
+
+inline auto SqlQueryResult::view(std::string_view name) -> Result<std::string_view> {
+    auto index = indexOf(name);
+    if (!index) {
+        return Unexpected<Error>(index.error());
+    }
+    return view(index.value());
+}
+
+inline auto SqlQueryResult::cell(size_t index) -> Result<SqlCell> {
+    if (mCurrentRow == nullptr) {
         return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
     }
+    loadFieldMetas();
+    if (index >= mFieldMetas.size()) {
+        return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
+    }
+    SqlCell cell;
+    cell.type       = mFieldMetas[index]->type;
+    cell.isUnsigned = (mFieldMetas[index]->flags & UNSIGNED_FLAG) != 0;
+    if (mCurrentRow[index] != nullptr) {
+        cell.kind = SqlCell::Text;
+        cell.text = std::string_view(mCurrentRow[index], mRowLengths[index]);
+    }
+    return cell;
+}
+
+inline auto SqlQueryResult::loadFieldMetas() -> void {
     if (mFieldMetas.empty()) {
         mFieldMetas.resize(mysql_num_fields(mResult));
         auto fieldMetas = mysql_fetch_fields(mResult);
+        mDecoders.resize(mFieldMetas.size());
         for (size_t i = 0; i < mFieldMetas.size(); ++i) {
             mFieldMetas[i] = &fieldMetas[i];
+            mDecoders[i]   = selectDecoder(fieldMetas[i], false);
         }
+        mColumns.build(fieldMetas, mFieldMetas.size());
+        ++mGeneration;
     }
-    if (mFieldMetas.empty()) {
+}
+
+inline auto SqlQueryResult::indexOf(std::string_view name) -> Result<size_t> {
+    if (mResult == nullptr) {
         return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
     }
-    std::size_t index = -1;
-    for (size_t i = 0; i < mysql_num_fields(mResult); ++i) {
-        if (mFieldMetas[i]->name == name) {
-            index = i;
-            break;
-        }
-    }
-    if (index == (std::size_t)-1) {
-        return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
-    }
-    return get(index);
+    loadFieldMetas();
+    return mColumns.find(name);
 }
 
 inline auto SqlQueryResult::countRows() -> size_t {
@@ -351,38 +682,59 @@ inline auto SqlQueryResult::fetchRow() -> IoTask<MYSQL_ROW> {
     co_return row;
 }
 
+// a destructor can't wait for the unread rows of a streamed result, the connection reads them before its next command.
+inline auto SqlQueryResult::retire() -> void {
+    if (mPending && mResult != nullptr) {
+        mMysql->deferFreeResult(mResult, true);
+        mResult = nullptr;
+    }
+    mPending = false;
+    freeResult();
+}
+
 inline auto SqlQueryResult::freeResult() -> void {
     if (mResult != nullptr) {
         mysql_free_result(mResult);
         mResult     = nullptr;
         mCurrentRow = nullptr;
+        mRowLengths = nullptr;
         mFieldMetas.clear();
+        mDecoders.clear();
+        mColumns.clear();
     }
 }
 
 inline SqlStmtResult::SqlStmtResult(SqlStmtResult &&other) {
-    mMysql      = std::move(other.mMysql);
-    mStmt       = other.mStmt;
-    other.mStmt = nullptr;
+    mMysql         = std::move(other.mMysql);
+    mStmt          = other.mStmt;
+    mBorrowed      = other.mBorrowed;
+    mMode          = other.mMode;
+    mPending       = other.mPending;
+    other.mStmt    = nullptr;
+    other.mPending = false;
 }
 
 inline SqlStmtResult &SqlStmtResult::operator=(SqlStmtResult &&other) {
-    if (mStmt) {
-        ilias_wait close();
-    }
     if (this != &other) {
-        mMysql      = std::move(other.mMysql);
-        mStmt       = other.mStmt;
-        other.mStmt = nullptr;
+        retire();
+        mMysql         = std::move(other.mMysql);
+        mStmt          = other.mStmt;
+        mBorrowed      = other.mBorrowed;
+        mMode          = other.mMode;
+        mPending       = other.mPending;
+        other.mStmt    = nullptr;
+        other.mPending = false;
     }
     return *this;
 }
 
-inline SqlStmtResult::SqlStmtResult(std::shared_ptr<detail::MySql> sql, MYSQL_STMT *stmt) : mMysql(sql), mStmt(stmt) {
+inline SqlStmtResult::SqlStmtResult(std::shared_ptr<detail::MySql> sql, MYSQL_STMT *stmt, bool borrowed,
+                                    SqlResultMode mode)
+    : mMysql(sql), mStmt(stmt), mBorrowed(borrowed), mMode(mode) {
 }
 
 inline SqlStmtResult::~SqlStmtResult() {
-    ilias_wait close();
+    retire();
 }
 
 inline auto SqlStmtResult::getResult() -> IoTask<void> {
@@ -395,113 +747,189 @@ inline auto SqlStmtResult::getResult() -> IoTask<void> {
 }
 
 inline auto SqlStmtResult::next() -> IoTask<void> {
-    if (mResult == nullptr) {
-        auto ret = co_await (storeResult(&mResult) | ignoreCancellation);
-        if (!ret) {
+    while (true) {
+        if (mResult == nullptr) {
+            auto ret = co_await (storeResult(&mResult) | ignoreCancellation);
+            if (!ret) {
+                co_return Unexpected<Error>(ret.error());
+            }
+        }
+        auto ret = co_await fetchRow();
+        if (ret) {
+            co_return {};
+        }
+        if (ret.error() != SqlError::Code::OK) {
             co_return Unexpected<Error>(ret.error());
         }
+        auto next = co_await (nextResult() | ignoreCancellation);
+        if (!next) {
+            co_return Unexpected<Error>(next.error());
+        }
+        freeResult();
     }
-    auto ret = co_await fetchRow();
-    if (!ret && ret.error() != SqlError::Code::OK) {
-        co_return Unexpected<Error>(ret.error());
-    }
-    else if (ret) {
-        co_return {};
+}
+
+inline auto SqlStmtResult::field(size_t index) -> const MYSQL_FIELD * {
+    return index < mFieldMetas.size() ? mFieldMetas[index] : nullptr;
+}
+
+// rows of a stored statement result are fetched from memory, the end and errors are left to next().
+inline auto SqlStmtResult::nextLocal() -> Result<bool> {
+    if (mMode != SqlResultMode::Buffered || mResult == nullptr || mStmt == nullptr) {
+        return false;
     }
-    else {
-        auto ret = co_await (nextResult() | ignoreCancellation);
-        if (!ret) {
-            co_return Unexpected<Error>(ret.error());
+    auto ret = mysql_stmt_fetch(mStmt);
+    if (ret == MYSQL_DATA_TRUNCATED) {
+        auto grown = fetchTruncated();
+        if (!grown) {
+            return Unexpected<Error>(grown.error());
         }
-        freeResult();
-        co_return co_await next();
+        return true;
     }
+    return ret == 0;
 }
 
 inline auto SqlStmtResult::get(size_t index) -> Result<SqlResultType> {
-    if (mFields.empty() || mFieldMetas.empty()) {
+    if (mBinds == nullptr || mFieldMetas.empty()) {
         return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
     }
-    if (index < 0 || index >= mFieldMetas.size()) {
+    if (index >= mDecoders.size()) {
         return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
     }
-    auto &currentRow = mFields[mFieldMetas[index]->name];
-    // ILIAS_TRACE("sql", "{}({}) raw data {}: {}",
-    //             std::string_view(mFieldMetas[index]->name, mFieldMetas[index]->name_length),
-    //             (int)mFieldMetas[index]->type, mLengths[index], (char *)currentRow.get());
-    SqlResultType result;
-    switch (mFieldMetas[index]->type) {
-        case MYSQL_TYPE_TINY: // char
-            result.emplace<char>(*reinterpret_cast<int32_t *>(currentRow.get()));
-            break;
-        case MYSQL_TYPE_SHORT: // short
-        case MYSQL_TYPE_LONG:  // int
-        case MYSQL_TYPE_INT24:
-            result.emplace<int32_t>(*reinterpret_cast<int32_t *>(currentRow.get()));
-            break;
-        case MYSQL_TYPE_FLOAT:
-            result.emplace<float>(*reinterpret_cast<double *>(currentRow.get()));
+    if (mNulls[index]) {
+        return SqlResultType(nullptr);
+    }
+    if (isTruncated(index)) {
+        return Unexpected<Error>(SqlError::DATA_TRUNCATED);
+    }
+    return mDecoders[index](static_cast<const char *>(mBinds[index].buffer), mLengths[index]);
+}
+
+inline auto SqlStmtResult::get(std::string_view name) -> Result<SqlResultType> {
+    auto index = indexOf(name);
+    if (!index) {
+        return Unexpected<Error>(index.error());
+    }
+    return get(index.value());
+}
+
+// only string bound columns have their bytes in the buffer, numbers are already decoded to binary.
+inline auto SqlStmtResult::view(size_t index) -> Result<std::string_view> {
+    if (mBinds == nullptr || mFieldMetas.empty()) {
+        return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
+    }
+    if (index >= mFieldMetas.size()) {
+        return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
+    }
+    if (mBinds[index].buffer_type != MYSQL_TYPE_STRING) {
+        return Unexpected<Error>(SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR);
+    }
+    if (mNulls[index]) {
+        return std::string_view {};
+    }
+    if (isTruncated(index)) {
+        return Unexpected<Error>(SqlError::DATA_TRUNCATED);
+    }
+    return std::string_view(static_cast<const char *>(mBinds[index].buffer), mLengths[index]);
+}
+
+inline auto SqlStmtResult::view(std::string_view name) -> Result<std::string_view> {
+    auto index = indexOf(name);
+    if (!index) {
+        return Unexpected<Error>(index.error());
+    }
+    return view(index.value());
+}
+
+inline auto SqlStmtResult::cell(size_t index) -> Result<SqlCell> {
+    if (mBinds == nullptr || mFieldMetas.empty()) {
+        return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
+    }
+    if (index >= mFieldMetas.size()) {
+        return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
+    }
+    SqlCell cell;
+    cell.type       = mFieldMetas[index]->type;
+    cell.isUnsigned = mBinds[index].is_unsigned != 0;
+    if (mNulls[index]) {
+        return cell;
+    }
+    if (isTruncated(index)) {
+        return Unexpected<Error>(SqlError::DATA_TRUNCATED);
+    }
+    switch (mBinds[index].buffer_type) {
+        case MYSQL_TYPE_LONGLONG:
+            cell.kind = SqlCell::Integer;
+            memcpy(&cell.integer, mBinds[index].buffer, sizeof(cell.integer));
             break;
         case MYSQL_TYPE_DOUBLE:
-            result.emplace<double>(*reinterpret_cast<double *>(currentRow.get()));
-            break;
-        case MYSQL_TYPE_NULL:
-            result.emplace<std::nullptr_t>(nullptr);
-            break;
-        case MYSQL_TYPE_TIMESTAMP:
-        case MYSQL_TYPE_DATETIME:
-            result.emplace<SqlDate>(std::string_view((char *)currentRow.get(), mLengths[index]));
-            std::get<SqlDate>(result).time.time_type = MYSQL_TIMESTAMP_DATETIME;
-            break;
-        case MYSQL_TYPE_DATE:
-            result.emplace<SqlDate>(std::string_view((char *)currentRow.get(), mLengths[index]));
-            std::get<SqlDate>(result).time.time_type = MYSQL_TIMESTAMP_DATE;
-            break;
-        case MYSQL_TYPE_TIME:
-            result.emplace<SqlDate>(std::string_view((char *)currentRow.get(), mLengths[index]), "%H:%M:%S");
-            std::get<SqlDate>(result).time.time_type = MYSQL_TIMESTAMP_TIME;
-            break;
-        case MYSQL_TYPE_LONGLONG: // long long
-            result.emplace<int64_t>(*reinterpret_cast<int64_t *>(currentRow.get()));
+            cell.kind = SqlCell::Real;
+            memcpy(&cell.real, mBinds[index].buffer, sizeof(cell.real));
             break;
-        case MYSQL_TYPE_VARCHAR:
-        case MYSQL_TYPE_VAR_STRING:
         case MYSQL_TYPE_STRING:
-            result.emplace<std::string>(reinterpret_cast<char *>(currentRow.get()), mLengths[index]);
-            break;
-        case MYSQL_TYPE_BLOB:
-        case MYSQL_TYPE_LONG_BLOB:
-        case MYSQL_TYPE_MEDIUM_BLOB:
-        case MYSQL_TYPE_TINY_BLOB:
-            result.emplace<std::vector<std::byte>>(
-                std::vector<std::byte> {reinterpret_cast<std::byte *>((char *)currentRow.get()),
-                                        reinterpret_cast<std::byte *>((char *)currentRow.get()) + mLengths[index]});
+            cell.kind = SqlCell::Text;
+            cell.text = std::string_view(static_cast<const char *>(mBinds[index].buffer), mLengths[index]);
             break;
         default:
-            return Unexpected<Error>(SqlError::Code::UNKNOWN_ERROR);
+            break;
     }
-    return result;
+    return cell;
 }
 
-// TODO: optimize
-inline auto SqlStmtResult::get(std::string_view name) -> Result<SqlResultType> {
+inline auto SqlStmtResult::indexOf(std::string_view name) -> Result<size_t> {
     if (mResult == nullptr || mFieldMetas.empty()) {
         return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
     }
-    if (mFieldMetas.empty()) {
+    return mColumns.find(name);
+}
+
+inline auto SqlStmtResult::isTruncated(size_t index) const -> bool {
+    return mBinds[index].buffer_type == MYSQL_TYPE_STRING && mLengths[index] > mBinds[index].buffer_length;
+}
+
+inline auto SqlStmtResult::deferColumn(size_t index) -> Result<void> {
+    if (mBinds == nullptr || mFieldMetas.empty()) {
         return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
     }
-    auto index = -1;
-    for (size_t i = 0; i < mysql_num_fields(mResult); ++i) {
-        if (mFieldMetas[i]->name == name) {
-            index = i;
-            break;
-        }
+    if (index >= mFieldMetas.size()) {
+        return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
+    }
+    mDeferred[index] = true;
+    return {};
+}
+
+// the slot holds the value when it fits, else the bytes are copied out of the fetched row from offset.
+inline auto SqlStmtResult::readColumn(size_t index, size_t offset, std::span<std::byte> buffer) -> Result<size_t> {
+    if (mBinds == nullptr || mFieldMetas.empty()) {
+        return Unexpected<Error>(SqlError::Code::NO_MORE_DATA);
     }
-    if (index == -1) {
+    if (index >= mFieldMetas.size()) {
         return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
     }
-    return get(index);
+    if (mBinds[index].buffer_type != MYSQL_TYPE_STRING) {
+        return Unexpected<Error>(SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR);
+    }
+    if (mNulls[index] || offset >= mLengths[index]) {
+        return 0;
+    }
+    auto size = std::min<size_t>(buffer.size(), mLengths[index] - offset);
+    if (!isTruncated(index)) {
+        memcpy(buffer.data(), static_cast<const std::byte *>(mBinds[index].buffer) + offset, size);
+        return size;
+    }
+    MYSQL_BIND    bind;
+    unsigned long length = 0;
+    my_bool       isNull = 0;
+    memset(&bind, 0, sizeof(bind));
+    bind.buffer_type   = MYSQL_TYPE_STRING;
+    bind.buffer        = buffer.data();
+    bind.buffer_length = (unsigned long)size;
+    bind.length        = &length;
+    bind.is_null       = &isNull;
+    if (mysql_stmt_fetch_column(mStmt, &bind, (unsigned int)index, (unsigned long)offset) != 0) {
+        return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(mStmt));
+    }
+    return size;
 }
 
 inline auto SqlStmtResult::countRows() -> size_t {
@@ -522,12 +950,40 @@ inline auto SqlStmtResult::fetchRow() -> IoTask<void> {
             }
         }
     }
+    if (ret == MYSQL_DATA_TRUNCATED) {
+        co_return fetchTruncated();
+    }
     if (ret != 0) {
+        mPending = false;
         co_return Unexpected<Error>((SqlError::Code)ret);
     }
     co_return {};
 }
 
+// a value longer than its slot, read the column again from the fetched row into the growable buffer of the column.
+// that buffer stays bound, so the column only comes here again for a value longer than all the ones before.
+inline auto SqlStmtResult::fetchTruncated() -> Result<void> {
+    bool grown = false;
+    for (size_t i = 0; i < mFieldMetas.size(); ++i) {
+        if (mBinds[i].buffer_type != MYSQL_TYPE_STRING || mLengths[i] <= mBinds[i].buffer_length || mDeferred[i]) {
+            continue;
+        }
+        auto &buffer = mOverflow[i];
+        buffer.resize(std::max<size_t>(mLengths[i], buffer.size() * 2));
+        mBinds[i].buffer        = buffer.data();
+        mBinds[i].buffer_length = (unsigned long)buffer.size();
+        if (mysql_stmt_fetch_column(mStmt, &mBinds[i], (unsigned int)i, 0) != 0) {
+            return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(mStmt));
+        }
+        grown = true;
+    }
+    // the next rows are fetched into the grown buffers.
+    if (grown && mysql_stmt_bind_result(mStmt, mBinds.get()) != 0) {
+        return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(mStmt));
+    }
+    return {};
+}
+
 inline auto SqlStmtResult::freeResult() -> void {
     if (mResult != nullptr) {
         mysql_free_result(mResult);
@@ -535,17 +991,23 @@ inline auto SqlStmtResult::freeResult() -> void {
     }
 }
 
+// a streamed or cursor result only binds the buffers, the rows are read by fetchRow().
 inline auto SqlStmtResult::storeResult(MYSQL_RES **res) -> IoTask<void> {
     ILIAS_ASSERT(mStmt != nullptr);
-    int  ret;
-    auto status = mysql_stmt_store_result_start(&ret, mStmt);
-    if (status) {
-        while (status) {
-            ILIAS_TRACE("sql", "disconnect mysql waiting for status {}", status);
-            auto pret = co_await mMysql->pollStatus(status);
-            status    = mysql_stmt_store_result_cont(&ret, mStmt, status);
-            if (!pret) {
-                co_return Unexpected<Error>(pret.error());
+    if (mMode == SqlResultMode::Buffered) {
+        // the store then fills max_length, so the slots fit the longest value of the result.
+        my_bool updateMaxLength = 1;
+        mysql_stmt_attr_set(mStmt, STMT_ATTR_UPDATE_MAX_LENGTH, &updateMaxLength);
+        int  ret;
+        auto status = mysql_stmt_store_result_start(&ret, mStmt);
+        if (status) {
+            while (status) {
+                ILIAS_TRACE("sql", "disconnect mysql waiting for status {}", status);
+                auto pret = co_await mMysql->pollStatus(status);
+                status    = mysql_stmt_store_result_cont(&ret, mStmt, status);
+                if (!pret) {
+                    co_return Unexpected<Error>(pret.error());
+                }
             }
         }
     }
@@ -560,8 +1022,16 @@ inline auto SqlStmtResult::storeResult(MYSQL_RES **res) -> IoTask<void> {
     memset(mBinds.get(), 0, sizeof(MYSQL_BIND) * mFieldMetas.size());
     mLengths = std::make_unique<unsigned long[]>(mFieldMetas.size());
     memset(mLengths.get(), 0, sizeof(unsigned long) * mFieldMetas.size());
+    mNulls = std::make_unique<my_bool[]>(mFieldMetas.size());
+    mOverflow.clear();
+    mOverflow.resize(mFieldMetas.size());
+    mDeferred.assign(mFieldMetas.size(), false);
+    mDecoders.resize(mFieldMetas.size());
+    mColumns.build(fieldMetas, mFieldMetas.size());
+    ++mGeneration;
     for (size_t i = 0; i < mFieldMetas.size(); ++i) {
         mFieldMetas[i]        = &fieldMetas[i];
+        mDecoders[i]          = selectDecoder(*mFieldMetas[i], true);
         mBinds[i].is_unsigned = (mFieldMetas[i]->flags & UNSIGNED_FLAG) ? 1 : 0;
 
         switch (mFieldMetas[i]->type) {
@@ -601,24 +1071,31 @@ inline auto SqlStmtResult::storeResult(MYSQL_RES **res) -> IoTask<void> {
             case MYSQL_TYPE_GEOMETRY:
             case MYSQL_TYPE_DECIMAL:
             case MYSQL_TYPE_NEWDECIMAL:
-                mBinds[i].buffer_type = MYSQL_TYPE_STRING;
-                mBinds[i].buffer_length =
-                    mFieldMetas[i]->max_length ? mFieldMetas[i]->max_length : mFieldMetas[i]->length;
+                mBinds[i].buffer_type   = MYSQL_TYPE_STRING;
+                mBinds[i].buffer_length = boundSlotLength(*mFieldMetas[i], mMode == SqlResultMode::Buffered);
                 break;
             default:
                 co_return Unexpected<Error>(SqlError::Code::UNKNOWN_ERROR);
         }
-        mBinds[i].length = &mLengths[i];
-        if (mBinds[i].buffer_length > 0) {
-            mFields[mFieldMetas[i]->name] = std::make_unique<uint8_t[]>(mBinds[i].buffer_length);
-            memset(mFields[mFieldMetas[i]->name].get(), 0, mBinds[i].buffer_length);
-            mBinds[i].buffer = mFields[mFieldMetas[i]->name].get();
-        }
+        mBinds[i].length  = &mLengths[i];
+        mBinds[i].is_null = &mNulls[i];
+    }
+    // all slots in one allocation, 8 byte aligned for the bound numbers.
+    size_t arenaLength = 0;
+    for (size_t i = 0; i < mFieldMetas.size(); ++i) {
+        arenaLength += (mBinds[i].buffer_length + 7) & ~size_t(7);
+    }
+    mArena        = std::make_unique<std::byte[]>(arenaLength);
+    size_t offset = 0;
+    for (size_t i = 0; i < mFieldMetas.size(); ++i) {
+        mBinds[i].buffer = mArena.get() + offset;
+        offset += (mBinds[i].buffer_length + 7) & ~size_t(7);
     }
     auto bindRet = mysql_stmt_bind_result(mStmt, mBinds.get());
-    if (!bindRet) {
+    if (bindRet != 0) {
         co_return Unexpected<Error>(mMysql->lastError().error());
     }
+    mPending = mMode != SqlResultMode::Buffered;
     co_return {};
 }
 
@@ -639,43 +1116,26 @@ inline auto SqlStmtResult::nextResult() -> IoTask<void> {
     co_return {};
 }
 
-inline auto SqlStmtResult::close() -> IoTask<void> {
-    ILIAS_ASSERT(mStmt != nullptr);
-    my_bool ret;
-    auto    status = mysql_stmt_close_start(&ret, mStmt);
-    if (status) {
-        while (status) {
-            ILIAS_TRACE("sql", "disconnect mysql waiting for status {}", status);
-            auto pret = co_await mMysql->pollStatus(status);
-            status    = mysql_stmt_close_cont(&ret, mStmt, status);
-            if (!pret) {
-                co_return Unexpected<Error>(pret.error());
-            }
-        }
+// a result read to the end is freed here, the reset skipping unread rows or closing the cursor is a round trip and
+// is left to the connection with the statement.
+inline auto SqlStmtResult::retire() -> void {
+    if (mStmt == nullptr) {
+        return;
     }
-    freeResult();
-    if (mStmt != nullptr) {
-        mysql_stmt_free_result(mStmt);
-        mStmt = nullptr;
+    if (mPending) {
+        mMysql->deferFreeStmt(mStmt, mResult, true, mBorrowed);
+        mResult = nullptr;
     }
-    co_return {};
-}
-
-inline auto SqlStmtResult::reset() -> IoTask<void> {
-    ILIAS_ASSERT(mStmt != nullptr);
-    my_bool ret;
-    auto    status = mysql_stmt_reset_start(&ret, mStmt);
-    if (status) {
-        while (status) {
-            ILIAS_TRACE("sql", "disconnect mysql waiting for status {}", status);
-            auto pret = co_await mMysql->pollStatus(status);
-            status    = mysql_stmt_reset_cont(&ret, mStmt, status);
-            if (!pret) {
-                co_return Unexpected<Error>(pret.error());
-            }
+    else {
+        freeResult();
+        mysql_stmt_free_result(mStmt);
+        // kept prepared for the owner or the next SqlQuery::prepare with the same sql.
+        if (!mBorrowed && !mMysql->stmtCache().release(mStmt)) {
+            mMysql->deferStmtClose(mStmt);
         }
     }
-    co_return {};
+    mStmt    = nullptr;
+    mPending = false;
 }
 } // namespace detail
 
@@ -774,6 +1234,12 @@ inline auto SqlDate::setTime(std::string_view str, std::string_view fmt) -> void
     if (fmt == "") {
         fmt = "%Y-%m-%d %H:%M:%S";
     }
+    // the formats the server uses are parsed without a stream, these also keep the fractional seconds.
+    if ((fmt == "%Y-%m-%d %H:%M:%S" && detail::parseTemporal(str, MYSQL_TYPE_DATETIME, time)) ||
+        (fmt == "%Y-%m-%d" && detail::parseTemporal(str, MYSQL_TYPE_DATE, time)) ||
+        (fmt == "%H:%M:%S" && detail::parseTemporal(str, MYSQL_TYPE_TIME, time))) {
+        return;
+    }
     struct tm timeinfo;
     memset(&timeinfo, 0, sizeof(struct tm));
     std::istringstream istr((std::string(str)));
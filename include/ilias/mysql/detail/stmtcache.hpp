@@ -0,0 +1,176 @@
+/**
+ * @file stmtcache.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief per connection LRU cache of prepared statements
+ * @version 0.1
+ * @date 2025-02-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <functional>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <mariadb/mysql.h>
+
+#include "global.hpp"
+
+ILIAS_SQL_NS_BEGIN
+namespace detail {
+
+/**
+ * @brief LRU cache of MYSQL_STMT keyed by the rewritten sql.
+ *
+ * A statement taken with acquire() (or registered with insert()) is in use until it is given back with release(), in
+ * use statements are never evicted. Statements that are forgotten while in use (clear() or eviction failure) are not
+ * owned by the cache anymore, release() returns false for them and the caller has to close them.
+ */
+class SqlStmtCache {
+public:
+    explicit SqlStmtCache(std::size_t capacity = 64) : mCapacity(capacity) {}
+    ~SqlStmtCache();
+
+    SqlStmtCache(const SqlStmtCache &)            = delete;
+    SqlStmtCache &operator=(const SqlStmtCache &) = delete;
+
+    ///> take a idle prepared statement for sql, nullptr if not cached or already in use.
+    auto acquire(std::string_view sql) -> MYSQL_STMT *;
+    ///> register a freshly prepared statement as in use, return false if it can't be cached.
+    auto insert(std::string sql, MYSQL_STMT *stmt) -> bool;
+    ///> give back a statement, return false if the cache does not own it.
+    auto release(MYSQL_STMT *stmt) -> bool;
+    auto owns(MYSQL_STMT *stmt) const -> bool;
+    ///> close every idle statement through the closer and forget the in use ones.
+    auto clear() -> void;
+    ///> forget every statement, the idle ones are handed back to be closed by the caller.
+    auto detach() -> std::vector<MYSQL_STMT *>;
+
+    auto setCapacity(std::size_t capacity) -> void;
+    ///> how evicted statements are closed, mysql_stmt_close by default.
+    auto setCloser(std::function<void(MYSQL_STMT *)> closer) -> void { mCloser = std::move(closer); }
+    auto capacity() const -> std::size_t { return mCapacity; }
+    auto size() const -> std::size_t { return mEntries.size(); }
+
+private:
+    struct Entry {
+        std::string sql;
+        MYSQL_STMT *stmt  = nullptr;
+        bool        inUse = false;
+    };
+    using Iterator = std::list<Entry>::iterator;
+
+    auto evict(std::size_t target) -> void;
+    auto close(MYSQL_STMT *stmt) -> void;
+
+    std::list<Entry>                               mEntries; // most recently used first
+    std::unordered_map<std::string_view, Iterator> mBySql;
+    std::unordered_map<MYSQL_STMT *, Iterator>     mByStmt;
+    std::size_t                                    mCapacity;
+    std::function<void(MYSQL_STMT *)>              mCloser;
+};
+
+inline SqlStmtCache::~SqlStmtCache() {
+    clear();
+}
+
+inline auto SqlStmtCache::acquire(std::string_view sql) -> MYSQL_STMT * {
+    auto it = mBySql.find(sql);
+    if (it == mBySql.end() || it->second->inUse) {
+        return nullptr;
+    }
+    auto entry   = it->second;
+    entry->inUse = true;
+    mEntries.splice(mEntries.begin(), mEntries, entry);
+    return entry->stmt;
+}
+
+inline auto SqlStmtCache::insert(std::string sql, MYSQL_STMT *stmt) -> bool {
+    if (mBySql.contains(sql)) {
+        // the cached one is in use by someone else, keep this one private.
+        return false;
+    }
+    if (mEntries.size() >= mCapacity) {
+        evict(mCapacity == 0 ? 0 : mCapacity - 1);
+        if (mEntries.size() >= mCapacity) {
+            return false;
+        }
+    }
+    mEntries.push_front(Entry {std::move(sql), stmt, true});
+    auto entry = mEntries.begin();
+    mBySql.emplace(entry->sql, entry);
+    mByStmt.emplace(stmt, entry);
+    return true;
+}
+
+inline auto SqlStmtCache::release(MYSQL_STMT *stmt) -> bool {
+    auto it = mByStmt.find(stmt);
+    if (it == mByStmt.end()) {
+        return false;
+    }
+    it->second->inUse = false;
+    if (mEntries.size() > mCapacity) {
+        evict(mCapacity);
+    }
+    return true;
+}
+
+inline auto SqlStmtCache::owns(MYSQL_STMT *stmt) const -> bool {
+    return mByStmt.contains(stmt);
+}
+
+inline auto SqlStmtCache::clear() -> void {
+    for (auto stmt : detach()) {
+        close(stmt);
+    }
+}
+
+inline auto SqlStmtCache::detach() -> std::vector<MYSQL_STMT *> {
+    std::vector<MYSQL_STMT *> idle;
+    for (auto &entry : mEntries) {
+        if (!entry.inUse) {
+            idle.push_back(entry.stmt);
+        }
+    }
+    mBySql.clear();
+    mByStmt.clear();
+    mEntries.clear();
+    return idle;
+}
+
+inline auto SqlStmtCache::setCapacity(std::size_t capacity) -> void {
+    mCapacity = capacity;
+    evict(mCapacity);
+}
+
+// close least recently used idle statements until at most target are left.
+inline auto SqlStmtCache::evict(std::size_t target) -> void {
+    auto it = mEntries.end();
+    while (mEntries.size() > target && it != mEntries.begin()) {
+        --it;
+        if (it->inUse) {
+            continue;
+        }
+        ILIAS_TRACE("sql", "stmt cache evict: {}", it->sql);
+        close(it->stmt);
+        mBySql.erase(it->sql);
+        mByStmt.erase(it->stmt);
+        it = mEntries.erase(it);
+    }
+}
+
+inline auto SqlStmtCache::close(MYSQL_STMT *stmt) -> void {
+    if (mCloser) {
+        mCloser(stmt);
+    }
+    else {
+        mysql_stmt_close(stmt);
+    }
+}
+
+} // namespace detail
+ILIAS_SQL_NS_END
@@ -0,0 +1,345 @@
+/**
+ * @file sqlarrow.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief write result sets as an Arrow IPC stream
+ * @version 0.1
+ * @date 2025-02-26
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "detail/global.hpp"
+#include "sqlcolumns.hpp"
+#include "sqlresult.hpp"
+
+ILIAS_SQL_NS_BEGIN
+
+namespace detail {
+
+/**
+ * @brief The few flatbuffers the Arrow IPC messages need, written front to back.
+ *
+ * An offset (uoffset_t) only points forward, so an offset field is written as a placeholder and patched with patch()
+ * once the object it points to is appended. The vtable of a table is written right before the table.
+ */
+class FlatWriter {
+public:
+    struct Field {
+        uint16_t slot;
+        uint8_t  size;      ///> 1, 2, 4 or 8 for a scalar, 0 for an offset to an object appended later.
+        uint64_t value = 0; ///> the scalar, little endian on the wire.
+    };
+
+    ///> start a new buffer, its root offset is at 0.
+    auto begin() -> void;
+    ///> the position of the table, offsets[i] is the position of the i-th offset field of fields.
+    auto table(std::initializer_list<Field> fields, size_t *offsets = nullptr) -> size_t;
+    auto string(std::string_view text) -> size_t;
+    ///> a vector of count placeholders, element i is at the returned position + 4 + 4 * i.
+    auto offsetVector(size_t count) -> size_t;
+    ///> a vector of structs made of int64_t, values holds count * fields integers.
+    auto structVector(std::span<const int64_t> values, size_t count) -> size_t;
+    auto patch(size_t at, size_t target) -> void;
+    auto bytes() const -> std::span<const std::byte> { return mBuffer; }
+
+private:
+    auto align(size_t alignment) -> void;
+    auto put(uint64_t value, size_t size) -> void;
+    auto store(size_t at, uint64_t value, size_t size) -> void;
+
+    std::vector<std::byte> mBuffer;
+};
+
+inline auto FlatWriter::begin() -> void {
+    mBuffer.clear();
+    put(0, 4);
+}
+
+inline auto FlatWriter::align(size_t alignment) -> void {
+    mBuffer.resize((mBuffer.size() + alignment - 1) / alignment * alignment);
+}
+
+inline auto FlatWriter::put(uint64_t value, size_t size) -> void {
+    mBuffer.resize(mBuffer.size() + size);
+    store(mBuffer.size() - size, value, size);
+}
+
+inline auto FlatWriter::store(size_t at, uint64_t value, size_t size) -> void {
+    for (size_t i = 0; i < size; ++i) {
+        mBuffer[at + i] = std::byte(value >> (8 * i));
+    }
+}
+
+inline auto FlatWriter::table(std::initializer_list<Field> fields, size_t *offsets) -> size_t {
+    uint16_t slots    = 0;
+    size_t   maxAlign = 4;
+    uint16_t at[16]   = {};
+    for (auto &field : fields) {
+        slots    = std::max<uint16_t>(slots, field.slot + 1);
+        maxAlign = std::max<size_t>(maxAlign, field.size);
+    }
+    // the fields follow the soffset_t to the vtable, largest first so that each one is aligned.
+    uint16_t length = 4;
+    for (size_t size : {8, 4, 2, 1}) {
+        for (auto &field : fields) {
+            if ((field.size == 0 ? 4 : field.size) == size) {
+                length         = uint16_t((length + size - 1) / size * size);
+                at[field.slot] = length;
+                length         = uint16_t(length + size);
+            }
+        }
+    }
+    align(2);
+    auto vtable = mBuffer.size();
+    put(4 + 2 * slots, 2);
+    put(length, 2);
+    for (uint16_t i = 0; i < slots; ++i) {
+        put(at[i], 2);
+    }
+    align(maxAlign);
+    auto table = mBuffer.size();
+    mBuffer.resize(table + length);
+    store(table, uint32_t(int32_t(table - vtable)), 4);
+    for (auto &field : fields) {
+        if (field.size != 0) {
+            store(table + at[field.slot], field.value, field.size);
+        }
+        else if (offsets != nullptr) {
+            *offsets++ = table + at[field.slot];
+        }
+    }
+    return table;
+}
+
+inline auto FlatWriter::string(std::string_view text) -> size_t {
+    align(4);
+    auto pos = mBuffer.size();
+    put(text.size(), 4);
+    auto data = reinterpret_cast<const std::byte *>(text.data());
+    mBuffer.insert(mBuffer.end(), data, data + text.size());
+    put(0, 1);
+    return pos;
+}
+
+inline auto FlatWriter::offsetVector(size_t count) -> size_t {
+    align(4);
+    auto pos = mBuffer.size();
+    put(count, 4);
+    mBuffer.resize(mBuffer.size() + 4 * count);
+    return pos;
+}
+
+inline auto FlatWriter::structVector(std::span<const int64_t> values, size_t count) -> size_t {
+    // the elements are 8 aligned, the length right before them.
+    align(4);
+    if (mBuffer.size() % 8 == 0) {
+        put(0, 4);
+    }
+    auto pos = mBuffer.size();
+    put(count, 4);
+    for (auto value : values) {
+        put(uint64_t(value), 8);
+    }
+    return pos;
+}
+
+inline auto FlatWriter::patch(size_t at, size_t target) -> void {
+    store(at, target - at, 4);
+}
+
+/**
+ * @brief Encode the messages of an Arrow IPC stream (format version V5) from SqlColumnSet batches.
+ *
+ * Integer columns are Int64 (UInt64 for unsigned), Real columns Float64, Text columns LargeUtf8 or LargeBinary; these
+ * are the SqlColumnData arrays as they are, so a batch body is a copy of the columns with 8 byte padding.
+ */
+class ArrowEncoder {
+public:
+    auto schema(const SqlColumnSet &columns) -> std::span<const std::byte>;
+    auto batch(const SqlColumnSet &columns) -> std::span<const std::byte>;
+    auto end() -> std::span<const std::byte>;
+
+private:
+    enum : uint64_t {
+        MetadataV5        = 4,
+        HeaderSchema      = 1,
+        HeaderBatch       = 3,
+        TypeInt           = 2,
+        TypeFloatingPoint = 3,
+        TypeLargeBinary   = 19,
+        TypeLargeUtf8     = 20,
+        PrecisionDouble   = 2,
+        EndianBig         = 1,
+    };
+
+    // the continuation marker, metadata length and the metadata padded to 8.
+    auto frame() -> void;
+    auto addBuffer(const void *data, size_t length) -> void;
+
+    FlatWriter             mWriter;
+    std::vector<std::byte> mMessage;
+    std::vector<int64_t>   mNodes;   // FieldNode {length, null_count}
+    std::vector<int64_t>   mBuffers; // Buffer {offset, length}
+    std::vector<std::byte> mBody;
+};
+
+inline auto ArrowEncoder::frame() -> void {
+    auto metadata = mWriter.bytes();
+    auto length   = (metadata.size() + 7) / 8 * 8;
+    mMessage.assign(8 + length, std::byte(0));
+    for (size_t i = 0; i < 4; ++i) {
+        mMessage[i]     = std::byte(0xFF);
+        mMessage[4 + i] = std::byte(length >> (8 * i));
+    }
+    memcpy(mMessage.data() + 8, metadata.data(), metadata.size());
+}
+
+inline auto ArrowEncoder::schema(const SqlColumnSet &columns) -> std::span<const std::byte> {
+    size_t header = 0;
+    mWriter.begin();
+    auto message = mWriter.table({{0, 2, MetadataV5}, {1, 1, HeaderSchema}, {2, 0}}, &header);
+    mWriter.patch(0, message);
+    // the bodies are the column arrays as they are in memory, in native byte order.
+    size_t   fields     = 0;
+    uint64_t endianness = std::endian::native == std::endian::big ? uint64_t(EndianBig) : 0;
+    mWriter.patch(header, mWriter.table({{0, 2, endianness}, {1, 0}}, &fields));
+    auto vector = mWriter.offsetVector(columns.columnCount());
+    mWriter.patch(fields, vector);
+    for (size_t i = 0; i < columns.columnCount(); ++i) {
+        auto    &column = columns.column(i);
+        uint64_t type   = TypeFloatingPoint;
+        if (column.kind() == SqlColumnData::Integer) {
+            type = TypeInt;
+        }
+        else if (column.kind() == SqlColumnData::Text) {
+            type = column.isBinary() ? TypeLargeBinary : TypeLargeUtf8;
+        }
+        // name, type and children, Arrow readers want the children vector even when it is empty.
+        size_t offsets[3];
+        auto   field = mWriter.table({{0, 0}, {1, 1, 1}, {2, 1, type}, {3, 0}, {5, 0}}, offsets);
+        mWriter.patch(vector + 4 + 4 * i, field);
+        mWriter.patch(offsets[0], mWriter.string(column.name()));
+        if (type == TypeInt) {
+            mWriter.patch(offsets[1], mWriter.table({{0, 4, 64}, {1, 1, column.isUnsigned() ? 0u : 1u}}));
+        }
+        else if (type == TypeFloatingPoint) {
+            mWriter.patch(offsets[1], mWriter.table({{0, 2, PrecisionDouble}}));
+        }
+        else {
+            mWriter.patch(offsets[1], mWriter.table({}));
+        }
+        mWriter.patch(offsets[2], mWriter.offsetVector(0));
+    }
+    frame();
+    return mMessage;
+}
+
+inline auto ArrowEncoder::addBuffer(const void *data, size_t length) -> void {
+    mBuffers.push_back(int64_t(mBody.size()));
+    mBuffers.push_back(int64_t(length));
+    auto bytes = static_cast<const std::byte *>(data);
+    mBody.insert(mBody.end(), bytes, bytes + length);
+    mBody.resize((mBody.size() + 7) / 8 * 8);
+}
+
+inline auto ArrowEncoder::batch(const SqlColumnSet &columns) -> std::span<const std::byte> {
+    mNodes.clear();
+    mBuffers.clear();
+    mBody.clear();
+    for (auto &column : columns.columns()) {
+        mNodes.push_back(int64_t(column.size()));
+        mNodes.push_back(int64_t(column.nullCount()));
+        addBuffer(column.validity().data(), column.validity().size());
+        switch (column.kind()) {
+            case SqlColumnData::Integer:
+                addBuffer(column.integers().data(), column.integers().size_bytes());
+                break;
+            case SqlColumnData::Real:
+                addBuffer(column.reals().data(), column.reals().size_bytes());
+                break;
+            case SqlColumnData::Text:
+                addBuffer(column.offsets().data(), column.offsets().size_bytes());
+                addBuffer(column.data().data(), column.data().size_bytes());
+                break;
+        }
+    }
+    size_t header = 0;
+    mWriter.begin();
+    auto message = mWriter.table({{0, 2, MetadataV5}, {1, 1, HeaderBatch}, {2, 0}, {3, 8, mBody.size()}}, &header);
+    mWriter.patch(0, message);
+    size_t offsets[2];
+    mWriter.patch(header, mWriter.table({{0, 8, columns.size()}, {1, 0}, {2, 0}}, offsets));
+    mWriter.patch(offsets[0], mWriter.structVector(mNodes, mNodes.size() / 2));
+    mWriter.patch(offsets[1], mWriter.structVector(mBuffers, mBuffers.size() / 2));
+    frame();
+    mMessage.insert(mMessage.end(), mBody.begin(), mBody.end());
+    return mMessage;
+}
+
+inline auto ArrowEncoder::end() -> std::span<const std::byte> {
+    mMessage.assign(8, std::byte(0));
+    std::fill_n(mMessage.begin(), 4, std::byte(0xFF));
+    return mMessage;
+}
+
+} // namespace detail
+
+/**
+ * @brief Write the rest of the current result set as an Arrow IPC stream, to a file or any other sink.
+ *
+ * The rows are read by SqlResult::toColumns() batchRows at a time and each read is one record batch, so at most one
+ * batch is in memory. The schema is the columns of the result set, also when it has no rows. The stream stops at the
+ * end of the result set, the next one (multiple statements, CALL) can be written by calling this again. The Arrow types
+ * are the SqlColumnData kinds, temporal and decimal columns are text.
+ *
+ * @return the number of rows written.
+ */
+template <SqlByteSink Sink>
+[[nodiscard("Don't forget to use co_await")]]
+auto writeArrowStream(SqlResult &result, Sink &&sink, size_t batchRows = 64 * 1024) -> IoTask<size_t> {
+    detail::ArrowEncoder encoder;
+    size_t               rows   = 0;
+    bool                 schema = false;
+    auto                 set    = result.resultSet();
+    batchRows                   = std::max<size_t>(batchRows, 1);
+    while (true) {
+        // the rows of the next result set would not match the schema, the read stops before them.
+        auto columns = co_await result.toColumns(batchRows, set);
+        if (!columns) {
+            co_return Unexpected<Error>(columns.error());
+        }
+        if (!schema) {
+            if (auto ret = co_await sink(encoder.schema(columns.value())); !ret) {
+                co_return Unexpected<Error>(ret.error());
+            }
+            schema = true;
+        }
+        if (columns->size() > 0) {
+            if (auto ret = co_await sink(encoder.batch(columns.value())); !ret) {
+                co_return Unexpected<Error>(ret.error());
+            }
+            rows += columns->size();
+        }
+        if (columns->size() < batchRows || result.resultSet() != set) {
+            break;
+        }
+    }
+    if (auto ret = co_await sink(encoder.end()); !ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    co_return rows;
+}
+
+ILIAS_SQL_NS_END
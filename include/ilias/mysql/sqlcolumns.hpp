@@ -0,0 +1,265 @@
+/**
+ * @file sqlcolumns.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief column oriented result sets
+ * @version 0.1
+ * @date 2025-02-25
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mariadb/mysql.h>
+
+#include "detail/global.hpp"
+#include "detail/sqlparse.hpp"
+#include "detail/sqlresultp.hpp"
+
+ILIAS_SQL_NS_BEGIN
+
+class SqlColumnSet;
+
+/**
+ * @brief One column of a SqlColumnSet, the values of all rows in one contiguous array.
+ *
+ * Integer columns are int64_t (unsigned BIGINT keeps its bits), Real columns are double, every other type is Text: an
+ * offsets array of size() + 1 entries into one data array, row i is data[offsets[i], offsets[i + 1]). A NULL is 0 or
+ * an empty text, and a cleared bit in the validity bitmap (LSB first, the Arrow layout).
+ */
+class SqlColumnData {
+public:
+    enum Kind : uint8_t { Integer, Real, Text };
+
+    auto name() const -> std::string_view { return mName; }
+    auto type() const -> enum_field_types { return mType; }
+    auto isUnsigned() const -> bool { return mIsUnsigned; }
+    ///> a Text column of bytes rather than characters (BLOB, BINARY, BIT...).
+    auto isBinary() const -> bool { return mIsBinary; }
+    auto kind() const -> Kind { return mKind; }
+    auto size() const -> size_t { return mRows; }
+    auto nullCount() const -> size_t { return mNullCount; }
+    auto isNull(size_t row) const -> bool { return (mValidity[row / 8] & (1 << (row % 8))) == 0; }
+    auto integers() const -> std::span<const int64_t> { return mIntegers; }
+    auto reals() const -> std::span<const double> { return mReals; }
+    auto offsets() const -> std::span<const int64_t> { return mOffsets; }
+    auto data() const -> std::span<const char> { return mData; }
+    auto validity() const -> std::span<const uint8_t> { return mValidity; }
+    auto text(size_t row) const -> std::string_view;
+
+private:
+    auto reset(const MYSQL_FIELD &field, size_t rows) -> void;
+    auto append(const detail::SqlCell &cell) -> SqlError;
+    auto appendText(std::string_view text) -> void;
+
+    std::string          mName;
+    enum_field_types     mType       = MYSQL_TYPE_NULL;
+    bool                 mIsUnsigned = false;
+    bool                 mIsBinary   = false;
+    Kind                 mKind       = Text;
+    size_t               mRows       = 0;
+    size_t               mNullCount  = 0;
+    std::vector<int64_t> mIntegers;
+    std::vector<double>  mReals;
+    std::vector<int64_t> mOffsets;
+    std::vector<char>    mData;
+    std::vector<uint8_t> mValidity;
+
+    friend class SqlColumnSet;
+};
+
+/**
+ * @brief Rows of one result set stored column by column, read by SqlResult::toColumns().
+ */
+class SqlColumnSet {
+public:
+    auto size() const -> size_t { return mRows; }
+    auto columnCount() const -> size_t { return mColumns.size(); }
+    auto column(size_t index) const -> const SqlColumnData & { return mColumns[index]; }
+    ///> nullptr when there is no such column.
+    auto column(std::string_view name) const -> const SqlColumnData *;
+    auto columns() const -> std::span<const SqlColumnData> { return mColumns; }
+
+private:
+    auto reset(detail::SqlResultBase &result, size_t rows) -> void;
+    auto append(detail::SqlResultBase &result) -> Result<void>;
+
+    size_t                     mRows = 0;
+    std::vector<SqlColumnData> mColumns;
+
+    friend class SqlResult;
+};
+
+namespace detail {
+// the array a column is stored in, from the column type.
+inline auto columnKind(enum_field_types type) -> SqlColumnData::Kind {
+    switch (type) {
+        case MYSQL_TYPE_TINY:
+        case MYSQL_TYPE_SHORT:
+        case MYSQL_TYPE_LONG:
+        case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_LONGLONG:
+        case MYSQL_TYPE_YEAR:
+            return SqlColumnData::Integer;
+        case MYSQL_TYPE_FLOAT:
+        case MYSQL_TYPE_DOUBLE:
+            return SqlColumnData::Real;
+        default:
+            return SqlColumnData::Text;
+    }
+}
+
+// a type the binary charset (63) means raw bytes for, temporal and decimal columns report it too.
+inline auto isByteType(enum_field_types type) -> bool {
+    switch (type) {
+        case MYSQL_TYPE_VARCHAR:
+        case MYSQL_TYPE_VAR_STRING:
+        case MYSQL_TYPE_STRING:
+        case MYSQL_TYPE_TINY_BLOB:
+        case MYSQL_TYPE_MEDIUM_BLOB:
+        case MYSQL_TYPE_LONG_BLOB:
+        case MYSQL_TYPE_BLOB:
+        case MYSQL_TYPE_BIT:
+        case MYSQL_TYPE_GEOMETRY:
+            return true;
+        default:
+            return false;
+    }
+}
+} // namespace detail
+
+inline auto SqlColumnData::text(size_t row) const -> std::string_view {
+    return std::string_view(mData.data() + mOffsets[row], size_t(mOffsets[row + 1] - mOffsets[row]));
+}
+
+inline auto SqlColumnData::reset(const MYSQL_FIELD &field, size_t rows) -> void {
+    mName.assign(field.name, field.name_length);
+    mType       = field.type;
+    mIsUnsigned = (field.flags & UNSIGNED_FLAG) != 0;
+    mKind       = detail::columnKind(field.type);
+    mIsBinary   = mKind == Text && field.charsetnr == 63 && detail::isByteType(field.type);
+    rows        = std::min<size_t>(rows, 1024);
+    switch (mKind) {
+        case Integer:
+            mIntegers.reserve(rows);
+            break;
+        case Real:
+            mReals.reserve(rows);
+            break;
+        case Text:
+            mOffsets.reserve(rows + 1);
+            mOffsets.push_back(0);
+            break;
+    }
+    mValidity.reserve((rows + 7) / 8);
+}
+
+inline auto SqlColumnData::appendText(std::string_view text) -> void {
+    mData.insert(mData.end(), text.begin(), text.end());
+    mOffsets.push_back((int64_t)mData.size());
+}
+
+// the cell is converted when the protocol did not send it in the column kind (text protocol numbers, BIT...).
+inline auto SqlColumnData::append(const detail::SqlCell &cell) -> SqlError {
+    if (mRows % 8 == 0) {
+        mValidity.push_back(0);
+    }
+    if (cell.kind == detail::SqlCell::Null) {
+        ++mNullCount;
+    }
+    else {
+        mValidity.back() |= uint8_t(1 << (mRows % 8));
+    }
+    ++mRows;
+    switch (mKind) {
+        case Integer: {
+            int64_t value = 0;
+            if (cell.kind == detail::SqlCell::Integer) {
+                value = cell.integer;
+            }
+            else if (cell.kind == detail::SqlCell::Real) {
+                value = (int64_t)cell.real;
+            }
+            else if (cell.kind == detail::SqlCell::Text) {
+                uint64_t bits = 0;
+                bool ok = mIsUnsigned ? detail::parseInteger(cell.text, bits) : detail::parseInteger(cell.text, value);
+                if (!ok) {
+                    return SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR;
+                }
+                value = mIsUnsigned ? (int64_t)bits : value;
+            }
+            mIntegers.push_back(value);
+            break;
+        }
+        case Real: {
+            double value = 0;
+            if (cell.kind == detail::SqlCell::Real) {
+                value = cell.real;
+            }
+            else if (cell.kind == detail::SqlCell::Integer) {
+                value = cell.isUnsigned ? (double)(uint64_t)cell.integer : (double)cell.integer;
+            }
+            else if (cell.kind == detail::SqlCell::Text) {
+                auto [ptr, ec] = std::from_chars(cell.text.data(), cell.text.data() + cell.text.size(), value);
+                if (ec != std::errc() || ptr != cell.text.data() + cell.text.size()) {
+                    return SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR;
+                }
+            }
+            mReals.push_back(value);
+            break;
+        }
+        case Text: {
+            char buffer[32];
+            auto end = buffer;
+            if (cell.kind == detail::SqlCell::Integer) {
+                end = cell.isUnsigned ? std::to_chars(buffer, buffer + sizeof(buffer), (uint64_t)cell.integer).ptr
+                                      : std::to_chars(buffer, buffer + sizeof(buffer), cell.integer).ptr;
+            }
+            else if (cell.kind == detail::SqlCell::Real) {
+                end = std::to_chars(buffer, buffer + sizeof(buffer), cell.real).ptr;
+            }
+            appendText(cell.kind == detail::SqlCell::Text ? cell.text : std::string_view(buffer, end - buffer));
+            break;
+        }
+    }
+    return SqlError::OK;
+}
+
+inline auto SqlColumnSet::column(std::string_view name) const -> const SqlColumnData * {
+    auto iter = std::find_if(mColumns.begin(), mColumns.end(), [&](auto &column) { return column.name() == name; });
+    return iter == mColumns.end() ? nullptr : &*iter;
+}
+
+inline auto SqlColumnSet::reset(detail::SqlResultBase &result, size_t rows) -> void {
+    mRows = 0;
+    mColumns.clear();
+    mColumns.resize(result.columnCount());
+    for (size_t i = 0; i < mColumns.size(); ++i) {
+        mColumns[i].reset(*result.field(i), rows);
+    }
+}
+
+inline auto SqlColumnSet::append(detail::SqlResultBase &result) -> Result<void> {
+    for (size_t i = 0; i < mColumns.size(); ++i) {
+        auto cell = result.cell(i);
+        if (!cell) {
+            return Unexpected<Error>(cell.error());
+        }
+        auto error = mColumns[i].append(cell.value());
+        if (!error.isOk()) {
+            ILIAS_TRACE("sql", "column {} value can't be stored as its type", mColumns[i].name());
+            return Unexpected<Error>(error.error());
+        }
+    }
+    ++mRows;
+    return {};
+}
+
+ILIAS_SQL_NS_END
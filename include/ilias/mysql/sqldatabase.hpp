@@ -16,9 +16,19 @@
 #include <ilias/io/system_error.hpp>
 #include <ilias/net/poller.hpp>
 #include <ilias/net/sockfd.hpp>
+#include <ilias/sync/event.hpp>
+#include <ilias/task/decorator.hpp>
 #include <ilias/task/when_any.hpp>
 #include <mariadb/mysql.h>
 #include <mariadb/mysqld_error.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "detail/global.hpp"
 #include "detail/mysql.hpp"
@@ -26,6 +36,13 @@
 
 ILIAS_SQL_NS_BEGIN
 
+class SqlPipeline;
+
+struct SqlHost {
+    std::string    host;
+    unsigned short port = 3306;
+};
+
 class SqlDatabase {
 public:
     SqlDatabase();
@@ -44,10 +61,31 @@ public:
     auto setHost(std::string_view host) -> void;
     auto setPort(unsigned short port) -> void;
     auto setDatabase(std::string_view database) -> void;
+    ///> the unix socket of the server, used instead of TCP when the host is local (empty, localhost, 127.0.0.1, ::1).
+    auto setUnixSocket(std::string_view path) -> void;
+    ///> CLIENT_* flags of the handshake (CLIENT_COMPRESS, CLIENT_FOUND_ROWS...).
+    auto setClientFlag(unsigned long flags) -> void;
+    ///> a fallback of the host, open() races the host and the fallbacks in the order they were added.
+    auto addHost(std::string_view host, unsigned short port = 3306) -> void;
+    auto clearHosts() -> void;
+    ///> head start of a raced host before the next one is tried too, 250ms by default.
+    auto setConnectStagger(std::chrono::milliseconds stagger) -> void;
+    ///> resolve the host on the IoContext and try each of its addresses, on by default. Off leaves the name to the
+    ///> connector (a blocking lookup), as a TLS option or CLIENT_SSL does: the certificate is checked against it.
+    auto setResolveHost(bool resolve) -> void;
+    ///> how long the connections of this thread keep the addresses of a host, 0 looks it up on every open.
+    static auto setHostCacheTtl(std::chrono::milliseconds ttl) -> void;
     auto setConnectOptions(std::string_view options = "") -> void;
     auto getConnectOptions() -> std::string;
     auto isOpen() const -> bool;
     auto selectDb(std::string_view db) -> IoTask<void>;
+    ///> max prepared statements kept per connection by SqlQuery::prepare, 0 disables the cache.
+    auto setStmtCacheCapacity(std::size_t capacity) -> void;
+    ///> lower the stmt cache capacity to the server's max_prepared_stmt_count.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto fitStmtCacheToServer() -> IoTask<void>;
+    ///> queries sent back to back on this connection, defined in sqlpipeline.hpp.
+    auto pipeline() -> SqlPipeline;
     template <typename T>
         requires std::is_base_of_v<sqlopt::OptionBase, T>
     auto setOption(const T &option) -> SqlError;
@@ -56,10 +94,32 @@ public:
     auto getOption(T &option) -> SqlError;
 
 private:
+    struct Race;
+    // a setOption() call, the last one of an option is kept. Init commands add up, each command is kept once.
+    struct Option {
+        mysql_option                        name;
+        std::string                         command; // of MYSQL_INIT_COMMAND
+        std::function<int(detail::MySql &)> apply;
+    };
+
     auto mysql() -> std::shared_ptr<detail::MySql>;
     auto parserOptions() -> void;
+    auto makeMySql() -> std::shared_ptr<detail::MySql>;
+    static auto isLocalHost(std::string_view host) -> bool;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto connect(detail::MySql &mysql, const std::string &host, unsigned short port) -> IoTask<void>;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto openRace() -> IoTask<void>;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto connectRace(Race &race, size_t index) -> IoTask<size_t>;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto attempt(Race &race, size_t index) -> IoTask<size_t>;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto staggered(Race &race, size_t index) -> IoTask<size_t>;
 
     friend class SqlQuery;
+    friend class SqlPipeline;
+    friend class SqlConnectionPool;
 
 private:
     std::string                    mUserName       = "";
@@ -69,8 +129,24 @@ private:
     std::string                    mDatabase       = "";
     std::string                    mUnixSocket     = "";
     unsigned long                  mClientFlag     = 0;
+    bool                           mResolveHost    = true;
+    std::vector<SqlHost>           mHosts;
+    std::chrono::milliseconds      mConnectStagger = std::chrono::milliseconds(250);
     std::string                    mConnectOptions = "";
+    std::size_t                    mStmtCacheSize  = 64;
     std::shared_ptr<detail::MySql> mMySql          = nullptr;
+    // setOption() calls, replayed on the connections made by open().
+    std::vector<Option>            mOptions;
+};
+
+// the candidates of one open(), connection i is made by attempt i.
+struct SqlDatabase::Race {
+    std::vector<SqlHost>                        hosts;
+    std::vector<std::shared_ptr<detail::MySql>> connections;
+    std::vector<std::unique_ptr<Event>>         failed; // attempt i failed, the next one starts now
+    Event                                       allFailed;
+    size_t                                      failures = 0;
+    Error                                       error;
 };
 
 inline SqlDatabase::SqlDatabase() {
@@ -79,23 +155,39 @@ inline SqlDatabase::SqlDatabase() {
 
 inline SqlDatabase::SqlDatabase(const SqlDatabase &other)
     : mUserName(other.mUserName), mPassword(other.mPassword), mHost(other.mHost), mPort(other.mPort),
-      mDatabase(other.mDatabase), mMySql(other.mMySql) {
+      mDatabase(other.mDatabase), mUnixSocket(other.mUnixSocket), mClientFlag(other.mClientFlag),
+      mResolveHost(other.mResolveHost), mHosts(other.mHosts), mConnectStagger(other.mConnectStagger),
+      mConnectOptions(other.mConnectOptions), mStmtCacheSize(other.mStmtCacheSize), mMySql(other.mMySql),
+      mOptions(other.mOptions) {
 }
 
+// the last owner hands the connection to the reaper, mysql_close would block on the socket.
 inline SqlDatabase::~SqlDatabase() {
     if (mMySql.use_count() == 1) {
-        mMySql->close();
+        mMySql->retire();
     }
     mMySql.reset();
 }
 
+// the connection replaced goes to the reaper like the one of a destructed SqlDatabase.
 inline SqlDatabase &SqlDatabase::operator=(const SqlDatabase &other) {
-    mUserName = other.mUserName;
-    mPassword = other.mPassword;
-    mHost     = other.mHost;
-    mPort     = other.mPort;
-    mDatabase = other.mDatabase;
-    mMySql    = other.mMySql;
+    if (mMySql != other.mMySql && mMySql.use_count() == 1) {
+        mMySql->retire();
+    }
+    mUserName       = other.mUserName;
+    mPassword       = other.mPassword;
+    mHost           = other.mHost;
+    mPort           = other.mPort;
+    mDatabase       = other.mDatabase;
+    mUnixSocket     = other.mUnixSocket;
+    mClientFlag     = other.mClientFlag;
+    mResolveHost    = other.mResolveHost;
+    mHosts          = other.mHosts;
+    mConnectStagger = other.mConnectStagger;
+    mConnectOptions = other.mConnectOptions;
+    mStmtCacheSize  = other.mStmtCacheSize;
+    mMySql          = other.mMySql;
+    mOptions        = other.mOptions;
     return *this;
 }
 
@@ -114,13 +206,118 @@ inline auto SqlDatabase::open() -> IoTask<void> {
 }
 
 inline auto SqlDatabase::open(std::string_view username, std::string_view password) -> IoTask<void> {
-    if (mMySql.use_count() != 1) {
-        mMySql = std::make_shared<detail::MySql>();
-    }
     mUserName = std::string(username);
     mPassword = std::string(password);
+    if (!mHosts.empty()) {
+        co_return co_await openRace();
+    }
+    if (mMySql.use_count() != 1) {
+        mMySql = makeMySql();
+    }
+    mMySql->stmtCache().setCapacity(mStmtCacheSize);
+    mMySql->setResolveHost(mResolveHost);
+
+    co_return co_await connect(*mMySql, mHost, mPort);
+}
 
-    co_return co_await mMySql->connect(mHost, mUserName, mPassword, mDatabase, mPort);
+inline auto SqlDatabase::isLocalHost(std::string_view host) -> bool {
+    return host.empty() || host == "localhost" || host == "127.0.0.1" || host == "::1";
+}
+
+// the connector only takes the socket for a null host or localhost, any other host is a TCP connection.
+inline auto SqlDatabase::connect(detail::MySql &mysql, const std::string &host, unsigned short port) -> IoTask<void> {
+    if (!mUnixSocket.empty() && isLocalHost(host)) {
+        ILIAS_TRACE("sql", "connect through unix socket {}", mUnixSocket);
+        co_return co_await mysql.connect("localhost", mUserName, mPassword, mDatabase, port, mUnixSocket, mClientFlag);
+    }
+    co_return co_await mysql.connect(host, mUserName, mPassword, mDatabase, port, "", mClientFlag);
+}
+
+inline auto SqlDatabase::makeMySql() -> std::shared_ptr<detail::MySql> {
+    auto mysql = std::make_shared<detail::MySql>();
+    for (auto &option : mOptions) {
+        option.apply(*mysql);
+    }
+    mysql->stmtCache().setCapacity(mStmtCacheSize);
+    mysql->setResolveHost(mResolveHost);
+    return mysql;
+}
+
+// every candidate gets its own connection, the winner becomes this database's and the others go to the reaper.
+inline auto SqlDatabase::openRace() -> IoTask<void> {
+    Race race;
+    if (!mHost.empty()) {
+        race.hosts.push_back(SqlHost {mHost, mPort});
+    }
+    race.hosts.insert(race.hosts.end(), mHosts.begin(), mHosts.end());
+    for (size_t i = 0; i < race.hosts.size(); ++i) {
+        race.connections.push_back(makeMySql());
+        race.failed.push_back(std::make_unique<Event>());
+    }
+    auto winner = co_await connectRace(race, 0);
+    for (size_t i = 0; i < race.connections.size(); ++i) {
+        if (!winner || i != winner.value()) {
+            race.connections[i]->retire();
+        }
+    }
+    if (!winner) {
+        co_return Unexpected<Error>(winner.error());
+    }
+    ILIAS_TRACE("sql", "connected to {}:{}", race.hosts[*winner].host, race.hosts[*winner].port);
+    if (mMySql.use_count() == 1) {
+        mMySql->retire();
+    }
+    mMySql = race.connections[*winner];
+    co_return {};
+}
+
+// attempt index races the ones after it, whenAny cancels the losers once a connection is made.
+inline auto SqlDatabase::connectRace(Race &race, size_t index) -> IoTask<size_t> {
+    if (index + 1 == race.hosts.size()) {
+        co_return co_await attempt(race, index);
+    }
+    auto [mine, later] = co_await whenAny(attempt(race, index), staggered(race, index + 1));
+    if (mine) {
+        co_return std::move(*mine);
+    }
+    if (later) {
+        co_return std::move(*later);
+    }
+    co_return Unexpected<Error>(Error::Canceled);
+}
+
+// a failure doesn't end the race, only a connection or the failure of every candidate does.
+inline auto SqlDatabase::attempt(Race &race, size_t index) -> IoTask<size_t> {
+    auto &host = race.hosts[index];
+    ILIAS_TRACE("sql", "connect attempt {} to {}:{}", index, host.host, host.port);
+    auto ret = co_await connect(*race.connections[index], host.host, host.port);
+    if (ret) {
+        co_return index;
+    }
+    if (ret.error() == Error::Canceled) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    ILIAS_WARN("sql", "connect to {}:{} failed, {}", host.host, host.port, ret.error().message());
+    race.error = ret.error();
+    race.failed[index]->set();
+    if (++race.failures == race.hosts.size()) {
+        race.allFailed.set();
+    }
+    co_await race.allFailed;
+    co_return Unexpected<Error>(race.error);
+}
+
+// the attempt before gets a head start, cut short when it fails.
+inline auto SqlDatabase::staggered(Race &race, size_t index) -> IoTask<size_t> {
+    auto failed = [](Event &event) -> IoTask<void> {
+        co_await event;
+        co_return {};
+    };
+    auto waited = co_await (failed(*race.failed[index - 1]) | setTimeout(mConnectStagger));
+    if (!waited && waited.error() != Error::TimedOut) {
+        co_return Unexpected<Error>(waited.error());
+    }
+    co_return co_await connectRace(race, index);
 }
 
 inline auto SqlDatabase::selectDb(std::string_view db) -> IoTask<void> {
@@ -132,6 +329,46 @@ inline auto SqlDatabase::selectDb(std::string_view db) -> IoTask<void> {
     co_return {};
 }
 
+inline auto SqlDatabase::setStmtCacheCapacity(std::size_t capacity) -> void {
+    mStmtCacheSize = capacity;
+    if (mMySql) {
+        mMySql->stmtCache().setCapacity(capacity);
+    }
+}
+
+inline auto SqlDatabase::fitStmtCacheToServer() -> IoTask<void> {
+    auto ret = co_await mMySql->query("SELECT @@max_prepared_stmt_count");
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    MYSQL_RES *result = nullptr;
+    ret               = co_await mMySql->storeResult(&result);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    // the result is already buffered, fetching the row does no I/O.
+    std::size_t limit  = 0;
+    bool        parsed = false;
+    auto        row    = mysql_fetch_row(result);
+    if (row != nullptr && row[0] != nullptr) {
+        auto end = row[0] + strlen(row[0]);
+        auto ret = std::from_chars(row[0], end, limit);
+        parsed   = ret.ec == std::errc() && ret.ptr == end;
+    }
+    mysql_free_result(result);
+    if (!parsed) {
+        // a limit of 0 would turn the cache off, keep the capacity when the server didn't tell.
+        ILIAS_WARN("sql", "max_prepared_stmt_count unknown, stmt cache capacity stays {}", mStmtCacheSize);
+        co_return {};
+    }
+    // never keep more statements than the server allows in total.
+    if (limit < mStmtCacheSize) {
+        ILIAS_TRACE("sql", "stmt cache capacity limited to max_prepared_stmt_count {}", limit);
+        setStmtCacheCapacity(limit);
+    }
+    co_return {};
+}
+
 inline auto SqlDatabase::setUserName(std::string_view username) -> void {
     mUserName = std::string(username);
 }
@@ -152,6 +389,34 @@ inline auto SqlDatabase::setDatabase(std::string_view database) -> void {
     mDatabase = std::string(database);
 }
 
+inline auto SqlDatabase::setUnixSocket(std::string_view path) -> void {
+    mUnixSocket = std::string(path);
+}
+
+inline auto SqlDatabase::setClientFlag(unsigned long flags) -> void {
+    mClientFlag = flags;
+}
+
+inline auto SqlDatabase::addHost(std::string_view host, unsigned short port) -> void {
+    mHosts.push_back(SqlHost {std::string(host), port});
+}
+
+inline auto SqlDatabase::clearHosts() -> void {
+    mHosts.clear();
+}
+
+inline auto SqlDatabase::setConnectStagger(std::chrono::milliseconds stagger) -> void {
+    mConnectStagger = stagger;
+}
+
+inline auto SqlDatabase::setResolveHost(bool resolve) -> void {
+    mResolveHost = resolve;
+}
+
+inline auto SqlDatabase::setHostCacheTtl(std::chrono::milliseconds ttl) -> void {
+    detail::SqlResolver::current().setTtl(ttl);
+}
+
 inline auto SqlDatabase::close() -> IoTask<void> {
     co_return co_await mMySql->disconnect();
 }
@@ -172,6 +437,21 @@ auto SqlDatabase::setOption(const T &option) -> SqlError {
     if (ret != 0) {
         ILIAS_ERROR("sql", "set option error {}", ret);
     }
+    else {
+        std::string command;
+        if constexpr (T::option == MYSQL_INIT_COMMAND) {
+            command = option.value();
+        }
+        auto apply = [option](detail::MySql &mysql) { return mysql.setOpt(option); };
+        auto iter  = std::find_if(mOptions.begin(), mOptions.end(),
+                                  [&](auto &entry) { return entry.name == T::option && entry.command == command; });
+        if (iter != mOptions.end()) {
+            iter->apply = std::move(apply);
+        }
+        else {
+            mOptions.push_back(Option {T::option, std::move(command), std::move(apply)});
+        }
+    }
     return (SqlError::Code)ret;
 }
 
@@ -0,0 +1,216 @@
+/**
+ * @file sqlmapping.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief declarative row to struct mapping
+ * @version 0.1
+ * @date 2025-02-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "detail/global.hpp"
+#include "detail/sqlresultp.hpp"
+
+ILIAS_SQL_NS_BEGIN
+
+/**
+ * @brief One mapped member, the column name and the member it is decoded into.
+ */
+template <typename Class, typename Member>
+struct SqlField {
+    std::string_view name;
+    Member Class::  *member;
+};
+
+template <typename Class, typename Member>
+constexpr auto sqlField(std::string_view name, Member Class::*member) -> SqlField<Class, Member> {
+    return {name, member};
+}
+
+/**
+ * @brief Specialize for a struct to decode rows into it with SqlResult::next<T>() and SqlResult::fetchAll().
+ *
+ * @code
+ * template <>
+ * struct ilias::sql::SqlMapping<Person> {
+ *     static constexpr auto fields = std::make_tuple(ILIAS_SQL_FIELD(Person, id), sqlField("name", &Person::name));
+ * };
+ * @endcode
+ * Members can be integers, floating points, std::string, std::string_view (valid until the next row),
+ * std::vector<std::byte>, SqlDate, or std::optional of them for NULL columns. A NULL decoded into a member that is not
+ * a std::optional resets it to its default value.
+ */
+template <typename T>
+struct SqlMapping;
+
+///> map a member to the column of the same name.
+#define ILIAS_SQL_FIELD(Type, member) ::ILIAS_SQL_COMPLETE_NAMESPACE::sqlField(#member, &Type::member)
+
+namespace detail {
+
+template <typename T>
+concept SqlMapped = requires { SqlMapping<T>::fields; };
+
+template <typename T>
+inline auto parseText(std::string_view text, T &out) -> SqlError {
+    if constexpr (std::is_same_v<T, bool>) {
+        int64_t value  = 0;
+        auto    result = parseText(text, value);
+        out            = value != 0;
+        return result;
+    }
+    else if constexpr (std::is_integral_v<T>) {
+        return parseInteger(text, out) ? SqlError::OK : SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR;
+    }
+    else {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        if (ec != std::errc() || ptr != text.data() + text.size()) {
+            return SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR;
+        }
+        return SqlError::OK;
+    }
+}
+
+// decode a cell straight into a member, without going through SqlResultType.
+template <typename T>
+inline auto fromCell(const SqlCell &cell, T &out) -> SqlError {
+    if constexpr (IsSqlOptional<T>::value) {
+        if (cell.kind == SqlCell::Null) {
+            out.reset();
+            return SqlError::OK;
+        }
+        return fromCell(cell, out.emplace());
+    }
+    else {
+        if (cell.kind == SqlCell::Null) {
+            out = T {};
+            return SqlError::OK;
+        }
+        if constexpr (std::is_integral_v<T> || std::is_floating_point_v<T>) {
+            switch (cell.kind) {
+                case SqlCell::Integer:
+                    out = cell.isUnsigned ? static_cast<T>(static_cast<uint64_t>(cell.integer))
+                                          : static_cast<T>(cell.integer);
+                    return SqlError::OK;
+                case SqlCell::Real:
+                    out = static_cast<T>(cell.real);
+                    return SqlError::OK;
+                default:
+                    return parseText(cell.text, out);
+            }
+        }
+        else if constexpr (std::is_same_v<T, std::string>) {
+            switch (cell.kind) {
+                case SqlCell::Integer:
+                    out = cell.isUnsigned ? std::to_string(static_cast<uint64_t>(cell.integer))
+                                          : std::to_string(cell.integer);
+                    return SqlError::OK;
+                case SqlCell::Real:
+                    out = std::to_string(cell.real);
+                    return SqlError::OK;
+                default:
+                    out.assign(cell.text);
+                    return SqlError::OK;
+            }
+        }
+        else if constexpr (std::is_same_v<T, std::string_view>) {
+            if (cell.kind != SqlCell::Text) {
+                return SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR;
+            }
+            out = cell.text;
+            return SqlError::OK;
+        }
+        else if constexpr (std::is_same_v<T, std::vector<std::byte>>) {
+            if (cell.kind != SqlCell::Text) {
+                return SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR;
+            }
+            auto bytes = reinterpret_cast<const std::byte *>(cell.text.data());
+            out.assign(bytes, bytes + cell.text.size());
+            return SqlError::OK;
+        }
+        else if constexpr (std::is_same_v<T, SqlDate>) {
+            if (cell.kind != SqlCell::Text) {
+                return SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR;
+            }
+            out = parseSqlDate(cell.text, cell.type);
+            return SqlError::OK;
+        }
+        else {
+            static_assert(!sizeof(T), "unsupported mapped member type");
+        }
+    }
+}
+
+// column indexes of the mapped fields, resolved once per result set.
+struct SqlMappingCache {
+    const void         *key        = nullptr;
+    size_t              generation = 0;
+    std::vector<size_t> indexes;
+};
+
+template <typename T>
+inline auto mappingKey() -> const void * {
+    static const char key = 0;
+    return &key;
+}
+
+template <typename Member>
+inline auto decodeField(SqlResultBase &result, size_t index, Member &member) -> Result<void> {
+    auto cell = result.cell(index);
+    if (!cell) {
+        return Unexpected<Error>(cell.error());
+    }
+    auto error = fromCell(cell.value(), member);
+    if (!error.isOk()) {
+        return Unexpected<Error>(error.error());
+    }
+    return {};
+}
+
+template <typename T, size_t... I>
+inline auto decodeFields(SqlResultBase &result, const SqlMappingCache &cache, T &out, std::index_sequence<I...>)
+    -> Result<void> {
+    constexpr auto &fields = SqlMapping<T>::fields;
+    Result<void>    ret;
+    // stops at the first member that fails.
+    (void)((ret = decodeField(result, cache.indexes[I], out.*(std::get<I>(fields).member))) && ...);
+    return ret;
+}
+
+template <SqlMapped T>
+inline auto decodeRow(SqlResultBase &result, SqlMappingCache &cache, T &out) -> Result<void> {
+    constexpr auto &fields = SqlMapping<T>::fields;
+    constexpr auto  kCount = std::tuple_size_v<std::remove_cvref_t<decltype(fields)>>;
+    if (cache.key != mappingKey<T>() || cache.generation != result.generation()) {
+        auto names = std::apply(
+            [](const auto &...field) { return std::array<std::string_view, kCount> {field.name...}; }, fields);
+        cache.key = nullptr;
+        cache.indexes.resize(kCount);
+        for (size_t i = 0; i < kCount; ++i) {
+            auto index = result.indexOf(names[i]);
+            if (!index) {
+                ILIAS_TRACE("sql", "mapped column {} not in result", names[i]);
+                return Unexpected<Error>(index.error());
+            }
+            cache.indexes[i] = index.value();
+        }
+        cache.key        = mappingKey<T>();
+        cache.generation = result.generation();
+    }
+    return decodeFields(result, cache, out, std::make_index_sequence<kCount> {});
+}
+
+} // namespace detail
+
+ILIAS_SQL_NS_END
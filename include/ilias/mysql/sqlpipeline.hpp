@@ -0,0 +1,111 @@
+/**
+ * @file sqlpipeline.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief send several queries before reading their results
+ * @version 0.1
+ * @date 2025-02-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mariadb/mysql.h>
+
+#include "detail/global.hpp"
+#include "detail/mysql.hpp"
+#include "detail/sqlresultp.hpp"
+#include "sqldatabase.hpp"
+#include "sqlresult.hpp"
+
+ILIAS_SQL_NS_BEGIN
+
+/**
+ * @brief Independent queries written back to back on one connection, their results are read afterwards in order, so
+ * the whole pipeline costs about one round trip.
+ *
+ * Every query gets its own result, a failed one doesn't stop the others (the server runs all of them). The results are
+ * buffered, and a query should make one result set: the extra ones of a multi statement query are discarded.
+ *
+ * @code
+ * auto p = db.pipeline();
+ * p.add("UPDATE t SET a = 1 WHERE id = 1");
+ * p.add("SELECT a FROM t");
+ * auto results = co_await p.run();
+ * @endcode
+ */
+class SqlPipeline {
+public:
+    explicit SqlPipeline(SqlDatabase &db) : mMysql(db.mysql()) {}
+
+    ///> the query is copied.
+    auto add(std::string_view query) -> void { mQueries.emplace_back(query); }
+    auto size() const -> size_t { return mQueries.size(); }
+    auto clear() -> void { mQueries.clear(); }
+    ///> one result per query in the order they were added, the queries are cleared.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto run() -> IoTask<std::vector<Result<SqlResult>>>;
+
+private:
+    [[nodiscard("Don't forget to use co_await")]]
+    auto readResult() -> IoTask<SqlResult>;
+
+    std::shared_ptr<detail::MySql> mMysql;
+    std::vector<std::string>       mQueries;
+};
+
+inline auto SqlDatabase::pipeline() -> SqlPipeline {
+    return SqlPipeline(*this);
+}
+
+inline auto SqlPipeline::readResult() -> IoTask<SqlResult> {
+    mMysql->resetSequence();
+    auto ret = co_await (mMysql->readQueryResult() | ignoreCancellation);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    auto sqlResult = std::make_unique<detail::SqlQueryResult>(mMysql, SqlResultMode::Buffered);
+    ret            = co_await sqlResult->getResult();
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    // the response of the next query follows the last result set of this one.
+    if (mMysql->moreResults()) {
+        ILIAS_WARN("sql", "pipelined query made more than one result set, the others are discarded");
+        ret = co_await mMysql->discardResults();
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+    }
+    co_return SqlResult(std::move(sqlResult));
+}
+
+// a query that can't be sent fails with the ones after it, the sent ones are still read to keep the connection usable.
+inline auto SqlPipeline::run() -> IoTask<std::vector<Result<SqlResult>>> {
+    auto queries = std::move(mQueries);
+    mQueries.clear();
+    std::vector<Result<SqlResult>> results;
+    results.reserve(queries.size());
+    size_t       sent = 0;
+    Result<void> ret;
+    for (; sent < queries.size(); ++sent) {
+        ILIAS_TRACE("sql", "pipeline query {}", queries[sent]);
+        ret = co_await (mMysql->sendQuery(queries[sent]) | ignoreCancellation);
+        if (!ret) {
+            break;
+        }
+    }
+    for (size_t i = 0; i < sent; ++i) {
+        results.push_back(co_await readResult());
+    }
+    while (results.size() < queries.size()) {
+        results.push_back(Unexpected<Error>(ret.error()));
+    }
+    co_return results;
+}
+
+ILIAS_SQL_NS_END
@@ -0,0 +1,337 @@
+/**
+ * @file sqlpool.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief coroutine-aware pool of warm mysql connections
+ * @version 0.1
+ * @date 2025-02-10
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <ilias/io/context.hpp>
+#include <ilias/io/method.hpp>
+#include <ilias/io/system_error.hpp>
+#include <ilias/sync/event.hpp>
+#include <ilias/task/decorator.hpp>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "detail/global.hpp"
+#include "detail/mysql.hpp"
+#include "sqldatabase.hpp"
+
+ILIAS_SQL_NS_BEGIN
+
+class SqlConnectionPool;
+
+/**
+ * @brief RAII handle of a connection borrowed from SqlConnectionPool.
+ *
+ * The connection goes back to the pool when the handle is destroyed or release() is called. SqlQuery objects built on
+ * top of it must not outlive the handle.
+ */
+class SqlPooledConnection {
+public:
+    SqlPooledConnection() = default;
+    SqlPooledConnection(SqlPooledConnection &&other) noexcept;
+    SqlPooledConnection &operator=(SqlPooledConnection &&other) noexcept;
+    ~SqlPooledConnection();
+
+    SqlPooledConnection(const SqlPooledConnection &)            = delete;
+    SqlPooledConnection &operator=(const SqlPooledConnection &) = delete;
+
+    auto database() -> SqlDatabase &;
+    auto release() -> void;
+
+    auto operator*() -> SqlDatabase & { return database(); }
+    auto operator->() -> SqlDatabase * { return &database(); }
+    explicit operator bool() const { return mPool != nullptr; }
+
+private:
+    SqlPooledConnection(SqlConnectionPool *pool, std::size_t slot) : mPool(pool), mSlot(slot) {}
+
+    SqlConnectionPool *mPool = nullptr;
+    std::size_t        mSlot = 0;
+
+    friend class SqlConnectionPool;
+};
+
+/**
+ * @brief Keeps up to maxSize connections open and hands them out to coroutines.
+ *
+ * Connections are opened lazily (or ahead of time with warmUp()), handed back through SqlPooledConnection and
+ * recycled with mysql_reset_connection() on their next acquire instead of paying a new handshake. When every
+ * connection is busy, acquire() waits in FIFO order until one is released or the timeout expires.
+ */
+class SqlConnectionPool {
+public:
+    ///> called on every new connection before it is opened, use it to apply sqlopt options.
+    using Setup = std::function<void(SqlDatabase &)>;
+
+    SqlConnectionPool(const SqlDatabase &prototype, std::size_t maxSize = 8, Setup setup = {});
+    ~SqlConnectionPool();
+
+    SqlConnectionPool(const SqlConnectionPool &)            = delete;
+    SqlConnectionPool &operator=(const SqlConnectionPool &) = delete;
+
+    ///> open count connections ahead of time.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto warmUp(std::size_t count) -> IoTask<void>;
+    ///> wait until a connection is available.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto acquire() -> IoTask<SqlPooledConnection>;
+    ///> wait until a connection is available, fail with Error::TimedOut after timeout.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto acquire(std::chrono::milliseconds timeout) -> IoTask<SqlPooledConnection>;
+
+    auto maxSize() const -> std::size_t;
+    ///> number of connections currently open.
+    auto size() const -> std::size_t;
+    ///> number of open connections not lent out.
+    auto idleCount() const -> std::size_t;
+    ///> number of coroutines waiting in acquire().
+    auto waitingCount() const -> std::size_t;
+
+private:
+    struct Slot {
+        SqlDatabase db;
+        bool        open  = false;
+        bool        busy  = false;
+        bool        dirty = false; // lent out before, need reset before next use.
+    };
+
+    struct Waiter {
+        Event       event;
+        std::size_t slot = kNoSlot;
+    };
+
+    static constexpr std::size_t kNoSlot = static_cast<std::size_t>(-1);
+
+    auto takeFree() -> std::size_t;
+    auto release(std::size_t slot) -> void;
+    auto prepareSlot(std::size_t slot) -> IoTask<void>;
+    auto openSlot(std::size_t slot) -> IoTask<void>;
+    auto waitFor(Waiter &waiter) -> IoTask<void>;
+    auto acquireImpl(std::optional<std::chrono::milliseconds> timeout) -> IoTask<SqlPooledConnection>;
+
+    SqlDatabase                        mPrototype;
+    Setup                              mSetup;
+    std::vector<std::unique_ptr<Slot>> mSlots;
+    std::deque<Waiter *>               mWaiters;
+
+    friend class SqlPooledConnection;
+};
+
+inline SqlPooledConnection::SqlPooledConnection(SqlPooledConnection &&other) noexcept
+    : mPool(other.mPool), mSlot(other.mSlot) {
+    other.mPool = nullptr;
+}
+
+inline SqlPooledConnection &SqlPooledConnection::operator=(SqlPooledConnection &&other) noexcept {
+    if (this != &other) {
+        release();
+        mPool       = other.mPool;
+        mSlot       = other.mSlot;
+        other.mPool = nullptr;
+    }
+    return *this;
+}
+
+inline SqlPooledConnection::~SqlPooledConnection() {
+    release();
+}
+
+inline auto SqlPooledConnection::database() -> SqlDatabase & {
+    ILIAS_ASSERT_MSG(mPool != nullptr, "use of released pooled connection");
+    return mPool->mSlots[mSlot]->db;
+}
+
+inline auto SqlPooledConnection::release() -> void {
+    if (mPool != nullptr) {
+        mPool->release(mSlot);
+        mPool = nullptr;
+    }
+}
+
+inline SqlConnectionPool::SqlConnectionPool(const SqlDatabase &prototype, std::size_t maxSize, Setup setup)
+    : mPrototype(prototype), mSetup(std::move(setup)) {
+    ILIAS_ASSERT_MSG(maxSize > 0, "pool size must be greater than 0");
+    // only keep the settings, the prototype connection itself is not part of the pool.
+    mPrototype.mMySql.reset();
+    mSlots.reserve(maxSize);
+    for (std::size_t i = 0; i < maxSize; ++i) {
+        mSlots.emplace_back(std::make_unique<Slot>(Slot {mPrototype}));
+    }
+}
+
+inline SqlConnectionPool::~SqlConnectionPool() {
+    ILIAS_ASSERT_MSG(mWaiters.empty(), "pool destroyed while coroutines are waiting in acquire()");
+    for (auto &slot : mSlots) {
+        ILIAS_ASSERT_MSG(!slot->busy, "pool destroyed while a connection is still lent out");
+    }
+}
+
+inline auto SqlConnectionPool::maxSize() const -> std::size_t {
+    return mSlots.size();
+}
+
+inline auto SqlConnectionPool::size() const -> std::size_t {
+    std::size_t count = 0;
+    for (auto &slot : mSlots) {
+        count += slot->open ? 1 : 0;
+    }
+    return count;
+}
+
+inline auto SqlConnectionPool::idleCount() const -> std::size_t {
+    std::size_t count = 0;
+    for (auto &slot : mSlots) {
+        count += (slot->open && !slot->busy) ? 1 : 0;
+    }
+    return count;
+}
+
+inline auto SqlConnectionPool::waitingCount() const -> std::size_t {
+    return mWaiters.size();
+}
+
+// prefer warm connections, fall back to a slot that has never been opened.
+inline auto SqlConnectionPool::takeFree() -> std::size_t {
+    auto closed = kNoSlot;
+    for (std::size_t i = 0; i < mSlots.size(); ++i) {
+        if (mSlots[i]->busy) {
+            continue;
+        }
+        if (mSlots[i]->open) {
+            mSlots[i]->busy = true;
+            return i;
+        }
+        if (closed == kNoSlot) {
+            closed = i;
+        }
+    }
+    if (closed != kNoSlot) {
+        mSlots[closed]->busy = true;
+    }
+    return closed;
+}
+
+inline auto SqlConnectionPool::release(std::size_t slot) -> void {
+    ILIAS_ASSERT(slot < mSlots.size() && mSlots[slot]->busy);
+    mSlots[slot]->dirty = true;
+    if (!mWaiters.empty()) {
+        // hand the connection over directly, it stays busy.
+        auto waiter = mWaiters.front();
+        mWaiters.pop_front();
+        waiter->slot = slot;
+        waiter->event.set();
+        return;
+    }
+    mSlots[slot]->busy = false;
+}
+
+inline auto SqlConnectionPool::openSlot(std::size_t slot) -> IoTask<void> {
+    auto &entry = *mSlots[slot];
+    // a connection whose reset failed is closed by the reaper, its socket may not answer anymore.
+    entry.db = mPrototype;
+    // a fresh MySql for this slot with the options of the prototype, SqlDatabase copies share their connection.
+    entry.db.mMySql = entry.db.makeMySql();
+    if (mSetup) {
+        mSetup(entry.db);
+    }
+    auto ret = co_await entry.db.open();
+    if (!ret) {
+        ILIAS_ERROR("sql", "pool open connection failed, {}", ret.error().message());
+        co_return Unexpected<Error>(ret.error());
+    }
+    entry.open  = true;
+    entry.dirty = false;
+    co_return {};
+}
+
+inline auto SqlConnectionPool::prepareSlot(std::size_t slot) -> IoTask<void> {
+    auto &entry = *mSlots[slot];
+    if (!entry.open) {
+        co_return co_await openSlot(slot);
+    }
+    if (!entry.dirty) {
+        co_return {};
+    }
+    // drop the session state of the previous user without a new handshake.
+    auto ret = co_await entry.db.mysql()->resetConnection();
+    if (ret) {
+        entry.dirty = false;
+        co_return {};
+    }
+    ILIAS_WARN("sql", "pool reset connection failed, reconnect. {}", ret.error().message());
+    entry.open = false;
+    co_return co_await openSlot(slot);
+}
+
+inline auto SqlConnectionPool::waitFor(Waiter &waiter) -> IoTask<void> {
+    co_await waiter.event;
+    co_return {};
+}
+
+inline auto SqlConnectionPool::warmUp(std::size_t count) -> IoTask<void> {
+    count = std::min(count, mSlots.size());
+    for (std::size_t i = 0; i < mSlots.size() && size() < count; ++i) {
+        if (mSlots[i]->open || mSlots[i]->busy) {
+            continue;
+        }
+        mSlots[i]->busy = true;
+        auto ret        = co_await openSlot(i);
+        release(i);
+        mSlots[i]->dirty = false;
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+    }
+    co_return {};
+}
+
+inline auto SqlConnectionPool::acquire() -> IoTask<SqlPooledConnection> {
+    co_return co_await acquireImpl(std::nullopt);
+}
+
+inline auto SqlConnectionPool::acquire(std::chrono::milliseconds timeout) -> IoTask<SqlPooledConnection> {
+    co_return co_await acquireImpl(timeout);
+}
+
+inline auto SqlConnectionPool::acquireImpl(std::optional<std::chrono::milliseconds> timeout)
+    -> IoTask<SqlPooledConnection> {
+    auto slot = takeFree();
+    if (slot == kNoSlot) {
+        Waiter waiter;
+        mWaiters.push_back(&waiter);
+        Result<void> ret;
+        if (timeout) {
+            ret = co_await (waitFor(waiter) | setTimeout(*timeout));
+        }
+        else {
+            ret = co_await waitFor(waiter);
+        }
+        if (waiter.slot == kNoSlot) {
+            // timed out or canceled before anyone released a connection.
+            std::erase(mWaiters, &waiter);
+            co_return Unexpected<Error>(ret ? Error(Error::TimedOut) : ret.error());
+        }
+        slot = waiter.slot;
+    }
+    // from here on the slot is ours, the handle gives it back on every exit path.
+    SqlPooledConnection conn(this, slot);
+    auto                ret = co_await prepareSlot(slot);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    co_return conn;
+}
+
+ILIAS_SQL_NS_END
@@ -21,6 +21,9 @@
 
 #include "detail/global.hpp"
 #include "detail/mysql.hpp"
+#include "detail/sqlbulk.hpp"
+#include "detail/sqllongdata.hpp"
+#include "detail/sqlparams.hpp"
 #include "detail/sqlresultp.hpp"
 #include "sqldatabase.hpp"
 #include "sqlresult.hpp"
@@ -39,12 +42,46 @@ public:
     SqlQuery &operator=(const SqlQuery &) = delete;
 
     [[nodiscard("Don't forget to use co_await")]]
-    auto execute(std::string_view query) -> IoTask<SqlResult>;
+    auto execute(std::string_view query, SqlResultMode mode = SqlResultMode::Buffered) -> IoTask<SqlResult>;
+    ///> run a statement for its counters only, no result is allocated for a statement without rows (rows are
+    ///> discarded).
+    [[nodiscard("Don't forget to use co_await")]]
+    auto exec(std::string_view query) -> IoTask<SqlExecInfo>;
+
+    ///> run the statements of a ';' separated query in one round trip, the cursor starts at the first statement.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto executeMulti(std::string_view statements) -> IoTask<SqlMultiResult>;
+    ///> join the statements with ';' and run them in one round trip.
+    template <typename Statements>
+        requires std::ranges::input_range<const Statements &> &&
+                 std::convertible_to<std::ranges::range_reference_t<const Statements &>, std::string_view>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto executeMulti(const Statements &statements) -> IoTask<SqlMultiResult> {
+        std::string joined;
+        for (std::string_view statement : statements) {
+            joined.append(statement).push_back(';');
+        }
+        co_return co_await executeMulti(std::string_view(joined));
+    }
 
     [[nodiscard("Don't forget to use co_await")]]
     auto prepare(std::string_view query) -> IoTask<void>;
     [[nodiscard("Don't forget to use co_await")]]
-    auto execute() -> IoTask<SqlResult>;
+    auto execute(SqlResultMode mode = SqlResultMode::Buffered) -> IoTask<SqlResult>;
+    ///> execute the prepared statement for its counters only, the statement stays prepared for the next execute.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto execPrepared() -> IoTask<SqlExecInfo>;
+    ///> execute the prepared statement once per row (a std::tuple of parameter values, std::optional for NULL) in a
+    ///> single bulk round trip, return the affected rows. The rows are only referenced during the call.
+    template <typename Row>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto executeBatch(std::span<const Row> rows) -> IoTask<uint64_t>;
+    template <typename Rows>
+        requires std::ranges::contiguous_range<const Rows &>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto executeBatch(const Rows &rows) -> IoTask<uint64_t> {
+        return executeBatch(std::span<const std::ranges::range_value_t<Rows>>(rows));
+    }
     ///> set TINYINT
     auto set(int index, signed char value) -> SqlError;
     ///> set SMALLINT
@@ -76,11 +113,17 @@ public:
     ///> set valueViwe, this api will not copy, Please ensure that the data is voalid during execute.
     template <typename T>
     auto setView(const std::string &name, const T &value) -> SqlError;
+    ///> set BLOB, TEXT from the chunks of source, sent to the server before execute without holding the whole value.
+    auto setStream(int index, SqlChunkSource source) -> SqlError;
+    ///> set BLOB, TEXT in chunkSize pieces (a mmap'd file...), this api will not copy, the data is used during execute.
+    auto setStream(int index, std::span<const std::byte> data, size_t chunkSize = 1024 * 1024) -> SqlError;
+    auto setStream(const std::string &name, SqlChunkSource source) -> SqlError;
 
     auto clearBinds() -> void;
 
 private:
     auto pareser(std::string_view query) -> std::string;
+    auto bindParams() -> Result<void>;
 
 private:
     std::shared_ptr<detail::MySql> mMysql;
@@ -90,17 +133,18 @@ private:
                                          mBindBuffer; // save var to continue it is life.
     std::vector<MYSQL_BIND>              mBinds;
     std::unordered_map<std::string, int> mIndexs;
+    detail::SqlLongData                  mLongData;
 };
 
 inline SqlQuery::SqlQuery(SqlDatabase &db) : mMysql(db.mysql()) {
 }
 
 inline SqlQuery::~SqlQuery() {
-    if (mMysqlStmt) {
-        mysql_stmt_close(mMysqlStmt);
+    if (mMysqlStmt && !mMysql->stmtCache().release(mMysqlStmt)) {
+        mMysql->deferStmtClose(mMysqlStmt);
     }
     if (mMysql.use_count() == 1) {
-        mMysql->close();
+        mMysql->retire();
     }
 }
 
@@ -116,14 +160,14 @@ inline SqlQuery &SqlQuery::operator=(SqlQuery &&other) noexcept {
     return *this;
 }
 
-inline auto SqlQuery::execute(std::string_view query) -> IoTask<SqlResult> {
+inline auto SqlQuery::execute(std::string_view query, SqlResultMode mode) -> IoTask<SqlResult> {
     ILIAS_ASSERT(mMysql != nullptr);
     ILIAS_TRACE("sql", "exec query {}", query);
     auto ret = co_await (mMysql->query(query) | ignoreCancellation);
     if (!ret) {
         co_return Unexpected<Error>(ret.error());
     }
-    auto sqlResult = std::make_unique<detail::SqlQueryResult>(mMysql);
+    auto sqlResult = std::make_unique<detail::SqlQueryResult>(mMysql, mode);
     auto ret1      = co_await sqlResult->getResult();
     if (!ret1) {
         co_return Unexpected<Error>(ret1.error());
@@ -131,34 +175,63 @@ inline auto SqlQuery::execute(std::string_view query) -> IoTask<SqlResult> {
     co_return SqlResult(std::move(sqlResult));
 }
 
-// this query should like "SELECT * FROM table WHERE name=:name,age=:age;"
-// return query like "SELECT * FROM table WHERE name=?,age=?;"
+inline auto SqlQuery::exec(std::string_view query) -> IoTask<SqlExecInfo> {
+    ILIAS_ASSERT(mMysql != nullptr);
+    ILIAS_TRACE("sql", "exec {}", query);
+    auto ret = co_await (mMysql->query(query) | ignoreCancellation);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    SqlExecInfo info {mMysql->affectedRows(), mMysql->insertId(), mMysql->warningCount()};
+    if (mMysql->fieldCount() > 0) {
+        MYSQL_RES *result = nullptr;
+        ret               = co_await (mMysql->storeResult(&result) | ignoreCancellation);
+        if (result != nullptr) {
+            info.affectedRows = mysql_num_rows(result);
+            mysql_free_result(result);
+        }
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+    }
+    ret = co_await mMysql->discardResults();
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    co_return info;
+}
+
+inline auto SqlQuery::executeMulti(std::string_view statements) -> IoTask<SqlMultiResult> {
+    ILIAS_ASSERT(mMysql != nullptr);
+    // only for this query, the multi result turns it off again.
+    bool restore = !mMysql->multiStatements();
+    if (restore) {
+        auto ret = co_await (mMysql->setServerOption(detail::MySql::MULTI_STATEMENTS_ON) | ignoreCancellation);
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+    }
+    ILIAS_TRACE("sql", "exec multi query {}", statements);
+    auto ret = co_await (mMysql->query(statements) | ignoreCancellation);
+    if (!ret) {
+        if (restore) {
+            mMysql->deferMultiStatementsOff();
+        }
+        co_return Unexpected<Error>(ret.error());
+    }
+    SqlMultiResult multi(mMysql, restore);
+    ret = co_await multi.load();
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    co_return multi;
+}
+
 inline auto SqlQuery::pareser(std::string_view query) -> std::string {
-    mIndexs.clear();
     mBindBuffer.clear();
     mBinds.clear();
-    std::string ret;
-    auto        start = query.find_first_of(':');
-    if (start != std::string::npos) {
-        ret = query.substr(0, start);
-    }
-    else {
-        return std::string(query);
-    }
-    auto end = start;
-    while (start != std::string::npos) {
-        end = start;
-        while (end < query.size() && query[end] != ' ' && query[end] != ',' && query[end] != '\t' &&
-               query[end] != '\n' && query[end] != '\r' && query[end] != ')' && query[end] != '(' &&
-               query[end] != '"') {
-            end++;
-        }
-        auto name = query.substr(start + 1, end - start - 1);
-        mIndexs.emplace(name, mIndexs.size());
-        ret += '?';
-        start = query.find_first_of(':', end);
-        ret += query.substr(end, start - end);
-    }
+    mLongData.clear();
+    auto ret = detail::rewriteNamedParams(query, mIndexs);
     mBinds.resize(mIndexs.size());
     memset(mBinds.data(), 0, sizeof(MYSQL_BIND) * mBinds.size());
     for (int i = 0; i < (int)mBinds.size(); ++i) {
@@ -169,28 +242,57 @@ inline auto SqlQuery::pareser(std::string_view query) -> std::string {
 }
 
 inline auto SqlQuery::prepare(std::string_view query) -> IoTask<void> {
+    if (mMysql->hasTeardown()) {
+        // the statements given back by dying results are released before the cache is looked up.
+        auto settled = co_await mMysql->settle();
+        if (!settled) {
+            co_return Unexpected<Error>(settled.error());
+        }
+    }
+    auto &cache  = mMysql->stmtCache();
+    auto  queryp = pareser(query);
+    if (mMysqlStmt != nullptr && cache.release(mMysqlStmt)) {
+        // the old statement stays prepared in the cache, don't re-prepare it.
+        mMysqlStmt = nullptr;
+    }
+    if (auto cached = cache.acquire(queryp); cached != nullptr) {
+        ILIAS_TRACE("sql", "prepare (cached) :{}", queryp);
+        if (mMysqlStmt != nullptr) {
+            mMysql->deferStmtClose(mMysqlStmt);
+        }
+        mMysqlStmt = cached;
+        co_return {};
+    }
     if (mMysqlStmt == nullptr) {
         mMysqlStmt = mMysql->stmtInit();
     }
-    int  ret;
-    auto queryp = pareser(query);
     ILIAS_TRACE("sql", "prepare :{}", queryp);
-    auto status = mysql_stmt_prepare_start(&ret, mMysqlStmt, queryp.data(), (unsigned long)queryp.size());
-    while (status) {
-        ILIAS_TRACE("sql", "stmt prepare waiting for status {}", status);
-        auto pret = co_await (mMysql->pollStatus(status) | ignoreCancellation);
-        if (!pret) {
-            co_return Unexpected<Error>(pret.error());
-        }
-        status = mysql_stmt_prepare_cont(&ret, mMysqlStmt, status);
+    auto ret = co_await mMysql->stmtPrepare(mMysqlStmt, queryp);
+    if (!ret && ret.error() == SqlError::Code::MAX_PREPARED_STMT_COUNT_REACHED && cache.size() > 0) {
+        // the server wide max_prepared_stmt_count is reached, give back half of our cached statements. stmtPrepare()
+        // settles first, the evicted statements are closed before the retry.
+        ILIAS_WARN("sql", "max_prepared_stmt_count reached, shrink stmt cache to {}", cache.size() / 2);
+        cache.setCapacity(cache.size() / 2);
+        ret = co_await mMysql->stmtPrepare(mMysqlStmt, queryp);
     }
-    if (ret != 0) {
-        ILIAS_ERROR("sql", "stmt failed, error: {}", mMysql->lastErrorMessage());
-        co_return Unexpected<Error>((SqlError::Code)ret);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
     }
+    cache.insert(std::move(queryp), mMysqlStmt);
     co_return {};
 }
 
+// the statement stays with the query, a next prepare() gives it back to the cache.
+template <typename Row>
+inline auto SqlQuery::executeBatch(std::span<const Row> rows) -> IoTask<uint64_t> {
+    if (mMysqlStmt == nullptr) {
+        co_return Unexpected<Error>(SqlError::Code::NOT_PREPARED);
+    }
+    detail::SqlBulkBinder binder;
+    binder.bind(rows);
+    co_return co_await detail::executeBulk(*mMysql, mMysqlStmt, binder);
+}
+
 template <typename T>
 inline auto SqlQuery::set(const std::string &name, const T &value) -> SqlError {
     auto index = mIndexs.find(name);
@@ -424,33 +526,59 @@ inline auto SqlQuery::setView(int index, std::span<const std::byte> value) -> Sq
     return SqlError::OK;
 }
 
-inline auto SqlQuery::execute() -> IoTask<SqlResult> {
+inline auto SqlQuery::setStream(int index, SqlChunkSource source) -> SqlError {
+    if (mMysqlStmt == nullptr) {
+        return SqlError::NOT_PREPARED;
+    }
+    if (index < 0 || index >= (int)mBinds.size()) {
+        return SqlError::INVALID_INDEX;
+    }
+    MYSQL_BIND bind;
+    memset(&bind, 0, sizeof(bind));
+    bind.buffer_type = MYSQL_TYPE_BLOB;
+    mBinds[index]    = bind;
+    mLongData.add(index, std::move(source));
+    return SqlError::OK;
+}
+
+inline auto SqlQuery::setStream(int index, std::span<const std::byte> data, size_t chunkSize) -> SqlError {
+    return setStream(index, chunksOf(data, chunkSize));
+}
+
+inline auto SqlQuery::setStream(const std::string &name, SqlChunkSource source) -> SqlError {
+    auto index = mIndexs.find(name);
+    if (index == mIndexs.end()) {
+        return SqlError::INVALID_INDEX;
+    }
+    return setStream(index->second, std::move(source));
+}
+
+inline auto SqlQuery::bindParams() -> Result<void> {
+    if (mBinds.size() > 0 && mysql_stmt_bind_param(mMysqlStmt, mBinds.data()) != 0) {
+        ILIAS_ERROR("sql", "stmt bind failed. (error {}:{})", mysql_stmt_errno(mMysqlStmt),
+                    mysql_stmt_error(mMysqlStmt));
+        return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(mMysqlStmt));
+    }
+    return {};
+}
+
+inline auto SqlQuery::execute(SqlResultMode mode) -> IoTask<SqlResult> {
     if (mMysqlStmt == nullptr) {
         co_return Unexpected<Error>(SqlError::Code::NOT_PREPARED);
     }
-    int ret = 0;
-    if (mBinds.size() > 0) {
-        ret = mysql_stmt_bind_param(mMysqlStmt, mBinds.data());
-    }
-    if (ret != 0) {
-        ILIAS_ERROR("sql", "stmt bind failed. (error {}:{})", ret, mMysql->lastErrorMessage());
-        co_return Unexpected<Error>((SqlError::Code)ret);
-    }
-    auto status = mysql_stmt_execute_start(&ret, mMysqlStmt);
-    while (status) {
-        ILIAS_TRACE("sql", "stmt execute waiting for status {}", status);
-        auto pret = co_await (mMysql->pollStatus(status) | ignoreCancellation);
-        if (!pret) {
-            ILIAS_ERROR("sql", "stmt execute failed. (error: {})", pret.error().message());
-            co_return Unexpected<Error>(pret.error());
-        }
-        status = mysql_stmt_execute_cont(&ret, mMysqlStmt, status);
+    if (auto bound = bindParams(); !bound) {
+        co_return Unexpected<Error>(bound.error());
     }
-    if (ret != 0) {
-        ILIAS_ERROR("sql", "stmt execute failed. (error {}:{})", ret, mMysql->lastErrorMessage());
-        co_return Unexpected<Error>((SqlError::Code)ret);
+    if (auto sent = co_await mLongData.send(*mMysql, mMysqlStmt); !sent) {
+        clearBinds();
+        co_return Unexpected<Error>(sent.error());
     }
-    auto sqlResult = std::make_unique<detail::SqlStmtResult>(mMysql, mMysqlStmt);
+    detail::applyResultMode(mMysqlStmt, mode);
+    auto ret = co_await mMysql->stmtExecute(mMysqlStmt);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    auto sqlResult = std::make_unique<detail::SqlStmtResult>(mMysql, mMysqlStmt, false, mode);
     auto ret1      = co_await sqlResult->getResult();
     clearBinds();
     mMysqlStmt = nullptr;
@@ -460,7 +588,39 @@ inline auto SqlQuery::execute() -> IoTask<SqlResult> {
     co_return SqlResult(std::move(sqlResult));
 }
 
+// rows of a statement are read into a borrowing result and freed, the statement is kept.
+inline auto SqlQuery::execPrepared() -> IoTask<SqlExecInfo> {
+    if (mMysqlStmt == nullptr) {
+        co_return Unexpected<Error>(SqlError::Code::NOT_PREPARED);
+    }
+    if (auto bound = bindParams(); !bound) {
+        co_return Unexpected<Error>(bound.error());
+    }
+    auto ret = co_await mLongData.send(*mMysql, mMysqlStmt);
+    if (!ret) {
+        clearBinds();
+        co_return Unexpected<Error>(ret.error());
+    }
+    detail::applyResultMode(mMysqlStmt, SqlResultMode::Buffered);
+    ret = co_await mMysql->stmtExecute(mMysqlStmt);
+    clearBinds();
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    SqlExecInfo info {mysql_stmt_affected_rows(mMysqlStmt), mysql_stmt_insert_id(mMysqlStmt), mMysql->warningCount()};
+    if (mysql_stmt_field_count(mMysqlStmt) > 0) {
+        detail::SqlStmtResult result(mMysql, mMysqlStmt, true, SqlResultMode::Buffered);
+        ret = co_await result.getResult();
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+        info.affectedRows = result.countRows();
+    }
+    co_return info;
+}
+
 inline auto SqlQuery::clearBinds() -> void {
+    mLongData.clear();
     memset(mBinds.data(), 0, sizeof(MYSQL_BIND) * mBinds.size());
     for (int i = 0; i < (int)mBinds.size(); ++i) {
         mBinds[i].buffer_type = MYSQL_TYPE_NULL;
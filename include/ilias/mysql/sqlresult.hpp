@@ -17,13 +17,72 @@
 #include <ilias/net/poller.hpp>
 #include <ilias/net/sockfd.hpp>
 #include <ilias/task/when_any.hpp>
+#include <algorithm>
+#include <concepts>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "detail/global.hpp"
 #include "detail/sqlresultp.hpp"
+#include "sqlcolumns.hpp"
+#include "sqlmapping.hpp"
+#include "sqlrow.hpp"
+#include "sqltext.hpp"
 
 ILIAS_SQL_NS_BEGIN
 
 class SqlQuery;
+class SqlPipeline;
+class SqlMultiResult;
+class SqlPreparedStatement;
+class SqlRowStream;
+
+/**
+ * @brief What a statement without rows (INSERT, UPDATE, DELETE, DDL) reports, returned by the exec() calls. For a
+ * statement that returned rows affectedRows is the number of rows.
+ */
+struct SqlExecInfo {
+    uint64_t     affectedRows = 0;
+    uint64_t     insertId     = 0; ///> the AUTO_INCREMENT value of the first inserted row, 0 when there is none.
+    unsigned int warnings     = 0;
+};
+
+/**
+ * @brief Where the exporters (writeText(), writeArrowStream()) write, it is called with each chunk of output and the
+ * bytes are only valid during the call.
+ *
+ * @code
+ * std::vector<std::byte> out;
+ * auto sink = [&](std::span<const std::byte> bytes) -> IoTask<void> {
+ *     out.insert(out.end(), bytes.begin(), bytes.end());
+ *     co_return {};
+ * };
+ * @endcode
+ */
+template <typename T>
+concept SqlByteSink = requires(T &sink, std::span<const std::byte> bytes) {
+    { sink(bytes) } -> std::same_as<IoTask<void>>;
+};
+
+///> a SqlByteSink writing to an ilias stream (a socket, a pipe or a file opened on a descriptor).
+template <typename Stream>
+auto streamSink(Stream &stream) {
+    return [&stream](std::span<const std::byte> bytes) -> IoTask<void> {
+        auto ret = co_await stream.writeAll(bytes);
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+        if (ret.value() != bytes.size()) {
+            co_return Unexpected<Error>(Error::Unknown);
+        }
+        co_return {};
+    };
+}
 
 class SqlResult {
 public:
@@ -36,56 +95,591 @@ public:
 
     [[nodiscard("Don't forget to use co_await")]]
     auto next() -> IoTask<void>;
+    ///> next row decoded into T, T needs a SqlMapping<T> specialization.
+    template <typename T>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto next() -> IoTask<T>;
+    ///> every remaining row decoded into a container of mapped structs, e.g. std::vector<Person>.
+    template <typename Container>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto fetchAll() -> IoTask<Container>;
+    ///> up to n rows in one call, rows already in memory are read without suspending. empty at the end of the rows.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto nextBatch(size_t n) -> IoTask<SqlRowBatch>;
+    ///> the remaining rows as an async range, read ahead prefetch rows at a time.
+    auto rows(size_t prefetch = 256) -> SqlRowStream;
+    ///> the rows of the current result set (at most maxRows of them) decoded into one array per column.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto toColumns(size_t maxRows = std::numeric_limits<size_t>::max()) -> IoTask<SqlColumnSet>;
+    ///> at most maxRows rows of the result set resultSet (a resultSet() value) and none of the next one, its first row
+    ///> is kept for the next read. the columns are there even when the result set has no rows left.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto toColumns(size_t maxRows, size_t resultSet) -> IoTask<SqlColumnSet>;
+    ///> the current result set, the value changes when the rows move on to the next one (multiple statements, CALL).
+    auto resultSet() const -> size_t;
+    ///> write the rest of the current result set as CSV or JSON Lines, formatted from the row buffers with no copy per
+    ///> cell. returns the number of rows written.
+    template <SqlByteSink Sink>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto writeText(Sink &&sink, SqlTextOptions options = {}) -> IoTask<size_t>;
     auto countRows() -> size_t;
+    auto columnCount() -> size_t;
     template <typename T>
     auto get(size_t index) -> Result<T>;
     template <typename T>
     auto get(std::string_view name) -> Result<T>;
+    ///> column bytes without a copy, valid until the next next(). a NULL value is an empty view.
+    auto getView(size_t index) -> Result<std::string_view>;
+    ///> column bytes without a copy, valid until the next next(). a NULL value is an empty view.
+    auto getView(std::string_view name) -> Result<std::string_view>;
+    ///> resolve a column name once, e.g. before the row loop.
+    auto column(std::string_view name) -> Result<SqlColumn>;
+    template <typename T>
+    auto get(SqlColumn column) -> Result<T>;
+    auto getView(SqlColumn column) -> Result<std::string_view>;
+    ///> don't read more of a large column than its first slot into the rows of the current result set, the value is
+    ///> then only read by readColumn() / writeColumn(), get() fails with DATA_TRUNCATED when it doesn't fit.
+    auto deferColumn(size_t index) -> Result<void>;
+    ///> copy the bytes of a column of the current row from offset, returns the bytes copied (0 at the end).
+    auto readColumn(size_t index, size_t offset, std::span<std::byte> buffer) -> Result<size_t>;
+    ///> write a column of the current row to the sink in chunkSize pieces, returns the bytes written.
+    template <SqlByteSink Sink>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto writeColumn(size_t index, Sink &&sink, size_t chunkSize = 64 * 1024) -> IoTask<size_t>;
 
 protected:
     inline SqlResult(std::unique_ptr<detail::SqlResultBase> imp) : mImp(std::move(imp)) {}
     friend class SqlQuery;
+    friend class SqlPipeline;
+    friend class SqlMultiResult;
+    friend class SqlPreparedStatement;
 
 private:
+    auto nextLocal() -> Result<bool>;
+    template <typename Rows>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto collect(Rows &rows, size_t n, std::optional<size_t> resultSet = std::nullopt) -> IoTask<void>;
+
     std::unique_ptr<detail::SqlResultBase> mImp;
+    detail::SqlMappingCache                mMapping;
+    bool                                   mHeld = false; // current row read by nextBatch() for the next call
+};
+
+/**
+ * @brief The rows of a SqlResult as an async range. Rows are read ahead a batch at a time, the rows of a batch are then
+ * handed out without any fetch, a view is valid until the iterator moves on.
+ *
+ * @code
+ * auto rows = result.rows();
+ * for (auto it = co_await rows.begin(); it != rows.end(); co_await ++it) {
+ *     auto id = it->get<int>(0);
+ * }
+ * @endcode
+ */
+class SqlRowStream {
+public:
+    class Iterator {
+    public:
+        auto operator*() const -> const SqlRowView & { return *mStream->mCurrent; }
+        auto operator->() const -> const SqlRowView * { return &*mStream->mCurrent; }
+        ///> an error ends the range, it is the result of the co_await.
+        [[nodiscard("Don't forget to use co_await")]]
+        auto operator++() -> IoTask<void>;
+        auto operator==(std::default_sentinel_t) const -> bool { return !mStream->mCurrent.has_value(); }
+
+    private:
+        explicit Iterator(SqlRowStream *stream) : mStream(stream) {}
+        SqlRowStream *mStream;
+
+        friend class SqlRowStream;
+    };
+
+    SqlRowStream(const SqlRowStream &)            = delete;
+    SqlRowStream &operator=(const SqlRowStream &) = delete;
+
+    [[nodiscard("Don't forget to use co_await")]]
+    auto begin() -> IoTask<Iterator>;
+    auto end() const -> std::default_sentinel_t { return {}; }
+    ///> the next row, std::nullopt after the last one.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto next() -> IoTask<std::optional<SqlRowView>>;
+
+private:
+    SqlRowStream(SqlResult &result, size_t prefetch) : mResult(&result), mPrefetch(prefetch) {}
+
+    SqlResult                *mResult;
+    size_t                    mPrefetch;
+    SqlRowBatch               mBatch;
+    size_t                    mIndex = 0;
+    bool                      mDone  = false;
+    std::optional<SqlRowView> mCurrent;
+
+    friend class SqlResult;
 };
 
+/**
+ * @brief The results of the statements of a multi statement query (SqlQuery::executeMulti()), one statement at a time.
+ *
+ * Each statement has its counters and, for a statement that returns rows, a SqlResult over its rows only. The results
+ * are buffered, nextResult() frees the current one. The results not read are drained when the cursor is destroyed.
+ * MULTI_STATEMENTS turned on for the query is turned off again before the next command of the connection.
+ *
+ * @code
+ * auto multi = co_await query.executeMulti("INSERT ...; UPDATE ...; SELECT ...");
+ * do {
+ *     auto affected = multi->affectedRows();
+ * } while (co_await multi->nextResult());
+ * @endcode
+ */
+class SqlMultiResult {
+public:
+    SqlMultiResult(SqlMultiResult &&) = default;
+    SqlMultiResult &operator=(SqlMultiResult &&other);
+    ~SqlMultiResult();
+
+    ///> the statement of the current result, from 0.
+    auto index() const -> size_t { return mIndex; }
+    ///> the current statement returned rows (SELECT, SHOW...).
+    auto hasRows() const -> bool { return mHasRows; }
+    auto affectedRows() const -> uint64_t { return mAffectedRows; }
+    auto insertId() const -> uint64_t { return mInsertId; }
+    ///> the rows of the current statement, there are none when !hasRows(). nullptr after the last result or a failed
+    ///> nextResult().
+    auto result() -> SqlResult * { return mResult ? &*mResult : nullptr; }
+    ///> move to the result of the next statement, false after the last one. an error is the error of that statement,
+    ///> the server does not run the statements after it.
+    [[nodiscard("Don't forget to use co_await")]]
+    auto nextResult() -> IoTask<bool>;
+
+private:
+    SqlMultiResult(std::shared_ptr<detail::MySql> mysql, bool restore) : mMysql(std::move(mysql)), mRestore(restore) {}
+    [[nodiscard("Don't forget to use co_await")]]
+    auto load() -> IoTask<void>;
+    ///> leave the unread results and the MULTI_STATEMENTS_OFF to the connection.
+    auto release() -> void;
+    auto restore() -> void;
+
+    std::shared_ptr<detail::MySql> mMysql;
+    std::optional<SqlResult>       mResult;
+    size_t                         mIndex        = 0;
+    bool                           mHasRows      = false;
+    bool                           mMore         = false;
+    bool                           mRestore      = false; // executeMulti() turned MULTI_STATEMENTS on
+    uint64_t                       mAffectedRows = 0;
+    uint64_t                       mInsertId     = 0;
+
+    friend class SqlQuery;
+};
+
+// the next row without a coroutine when there is one: a row held back by nextBatch() or a row of a buffered result.
+inline auto SqlResult::nextLocal() -> Result<bool> {
+    if (mHeld) {
+        mHeld = false;
+        return true;
+    }
+    return mImp->nextLocal();
+}
+
 inline auto SqlResult::next() -> IoTask<void> {
+    auto local = nextLocal();
+    if (!local) {
+        co_return Unexpected<Error>(local.error());
+    }
+    if (local.value()) {
+        co_return {};
+    }
     co_return co_await mImp->next();
 }
 
+template <typename T>
+auto SqlResult::next() -> IoTask<T> {
+    auto local = nextLocal();
+    if (!local) {
+        co_return Unexpected<Error>(local.error());
+    }
+    if (!local.value()) {
+        auto ret = co_await mImp->next();
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+    }
+    T    value {};
+    auto decoded = detail::decodeRow(*mImp, mMapping, value);
+    if (!decoded) {
+        co_return Unexpected<Error>(decoded.error());
+    }
+    co_return value;
+}
+
+template <typename Container>
+auto SqlResult::fetchAll() -> IoTask<Container> {
+    Container rows;
+    while (true) {
+        auto local = nextLocal();
+        if (!local) {
+            co_return Unexpected<Error>(local.error());
+        }
+        if (!local.value()) {
+            auto ret = co_await mImp->next();
+            if (!ret) {
+                if (detail::isEndOfRows(ret.error())) {
+                    break;
+                }
+                co_return Unexpected<Error>(ret.error());
+            }
+        }
+        auto decoded = detail::decodeRow(*mImp, mMapping, rows.emplace_back());
+        if (!decoded) {
+            co_return Unexpected<Error>(decoded.error());
+        }
+    }
+    co_return rows;
+}
+
+// read up to n rows of one result set into rows (a SqlRowBatch, a SqlColumnSet or a text encoder). the rows of a
+// given resultSet are reset for it up front, they have its columns even when no row is read.
+template <typename Rows>
+auto SqlResult::collect(Rows &rows, size_t n, std::optional<size_t> resultSet) -> IoTask<void> {
+    auto generation = resultSet;
+    if (generation && *generation == mImp->generation()) {
+        rows.reset(*mImp, n);
+    }
+    while (rows.size() < n) {
+        auto local = nextLocal();
+        if (!local) {
+            co_return Unexpected<Error>(local.error());
+        }
+        if (!local.value()) {
+            auto ret = co_await mImp->next();
+            if (!ret) {
+                if (detail::isEndOfRows(ret.error())) {
+                    break;
+                }
+                co_return Unexpected<Error>(ret.error());
+            }
+        }
+        if (!generation) {
+            rows.reset(*mImp, n);
+            generation = mImp->generation();
+        }
+        else if (*generation != mImp->generation()) {
+            // first row of the next result set, it starts the next batch.
+            mHeld = true;
+            break;
+        }
+        auto appended = rows.append(*mImp);
+        if (!appended) {
+            co_return Unexpected<Error>(appended.error());
+        }
+    }
+    co_return {};
+}
+
+inline auto SqlResult::nextBatch(size_t n) -> IoTask<SqlRowBatch> {
+    SqlRowBatch batch;
+    auto        ret = co_await collect(batch, n);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    co_return batch;
+}
+
+inline auto SqlResult::toColumns(size_t maxRows) -> IoTask<SqlColumnSet> {
+    SqlColumnSet columns;
+    auto         ret = co_await collect(columns, maxRows);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    co_return columns;
+}
+
+inline auto SqlResult::toColumns(size_t maxRows, size_t resultSet) -> IoTask<SqlColumnSet> {
+    SqlColumnSet columns;
+    auto         ret = co_await collect(columns, maxRows, resultSet);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    co_return columns;
+}
+
+inline auto SqlResult::resultSet() const -> size_t {
+    return mImp->generation();
+}
+
+template <SqlByteSink Sink>
+auto SqlResult::writeText(Sink &&sink, SqlTextOptions options) -> IoTask<size_t> {
+    detail::SqlTextEncoder encoder(options);
+    size_t                 rows      = 0;
+    auto                   batchRows = std::max<size_t>(options.batchRows, 1);
+    auto                   set       = mImp->generation();
+    encoder.header(*mImp);
+    while (true) {
+        // the rows of the next result set would be under this header, the read stops before them.
+        auto ret = co_await collect(encoder, batchRows, set);
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+        rows += encoder.size();
+        if (!encoder.bytes().empty()) {
+            if (auto written = co_await sink(encoder.bytes()); !written) {
+                co_return Unexpected<Error>(written.error());
+            }
+        }
+        if (encoder.size() < batchRows || mImp->generation() != set) {
+            break;
+        }
+        encoder.clear();
+    }
+    co_return rows;
+}
+
+// one chunk buffer for the whole value, a statement result copies each chunk straight out of the fetched row.
+template <SqlByteSink Sink>
+auto SqlResult::writeColumn(size_t index, Sink &&sink, size_t chunkSize) -> IoTask<size_t> {
+    std::vector<std::byte> buffer(std::max<size_t>(chunkSize, 1));
+    size_t                 offset = 0;
+    while (true) {
+        auto read = mImp->readColumn(index, offset, buffer);
+        if (!read) {
+            co_return Unexpected<Error>(read.error());
+        }
+        if (read.value() == 0) {
+            break;
+        }
+        if (auto written = co_await sink(std::span<const std::byte>(buffer.data(), read.value())); !written) {
+            co_return Unexpected<Error>(written.error());
+        }
+        offset += read.value();
+    }
+    co_return offset;
+}
+
+inline auto SqlResult::rows(size_t prefetch) -> SqlRowStream {
+    return SqlRowStream(*this, std::max<size_t>(prefetch, 1));
+}
+
+inline auto SqlRowStream::next() -> IoTask<std::optional<SqlRowView>> {
+    if (mIndex >= mBatch.size()) {
+        if (mDone) {
+            mCurrent.reset();
+            co_return std::nullopt;
+        }
+        auto batch = co_await mResult->nextBatch(mPrefetch);
+        if (!batch) {
+            mDone = true;
+            mCurrent.reset();
+            co_return Unexpected<Error>(batch.error());
+        }
+        mBatch = std::move(batch.value());
+        mIndex = 0;
+        if (mBatch.empty()) {
+            mDone = true;
+            mCurrent.reset();
+            co_return std::nullopt;
+        }
+    }
+    mCurrent = mBatch[mIndex++];
+    co_return mCurrent;
+}
+
+inline auto SqlRowStream::begin() -> IoTask<Iterator> {
+    auto row = co_await next();
+    if (!row) {
+        co_return Unexpected<Error>(row.error());
+    }
+    co_return Iterator(this);
+}
+
+inline auto SqlRowStream::Iterator::operator++() -> IoTask<void> {
+    auto row = co_await mStream->next();
+    if (!row) {
+        co_return Unexpected<Error>(row.error());
+    }
+    co_return {};
+}
+
 inline auto SqlResult::countRows() -> size_t {
     return mImp->countRows();
 }
 
+inline auto SqlResult::columnCount() -> size_t {
+    return mImp->columnCount();
+}
+
+inline auto SqlResult::getView(size_t index) -> Result<std::string_view> {
+    return mImp->view(index);
+}
+
+inline auto SqlResult::getView(std::string_view name) -> Result<std::string_view> {
+    return mImp->view(name);
+}
+
+inline auto SqlResult::column(std::string_view name) -> Result<SqlColumn> {
+    auto index = mImp->indexOf(name);
+    if (!index) {
+        return Unexpected<Error>(index.error());
+    }
+    return SqlColumn(index.value());
+}
+
+inline auto SqlResult::getView(SqlColumn column) -> Result<std::string_view> {
+    return mImp->view(column.index());
+}
+
+inline auto SqlResult::deferColumn(size_t index) -> Result<void> {
+    return mImp->deferColumn(index);
+}
+
+inline auto SqlResult::readColumn(size_t index, size_t offset, std::span<std::byte> buffer) -> Result<size_t> {
+    return mImp->readColumn(index, offset, buffer);
+}
+
+template <typename T>
+auto SqlResult::get(SqlColumn column) -> Result<T> {
+    return get<T>(column.index());
+}
+
+namespace detail {
+// the views are the only get<T> that skip SqlResultType, T is std::string_view or std::span<const std::byte>.
+template <typename T>
+constexpr bool IsSqlView = std::is_same_v<T, std::string_view> || std::is_same_v<T, std::span<const std::byte>>;
+
+template <typename T>
+inline auto castView(Result<std::string_view> view) -> Result<T> {
+    if (!view) {
+        return Unexpected<Error>(view.error());
+    }
+    if constexpr (std::is_same_v<T, std::string_view>) {
+        return view.value();
+    }
+    else {
+        return std::as_bytes(std::span(view->data(), view->size()));
+    }
+}
+} // namespace detail
+
 template <typename T>
 auto SqlResult::get(size_t index) -> Result<T> {
-    auto val = mImp->get(index);
-    if (!val) {
-        ILIAS_TRACE("sql", "no column value: {}", index);
-        return Unexpected<Error>(val.error());
+    if constexpr (detail::IsSqlView<T>) {
+        return detail::castView<T>(mImp->view(index));
     }
-    auto res = std::get_if<T>(&val.value());
-    if (res == nullptr) {
-        ILIAS_TRACE("sql", "Wrong type of column value: {}", index);
-        return Unexpected<Error>(SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR);
+    else {
+        auto val = mImp->get(index);
+        if (!val) {
+            ILIAS_TRACE("sql", "no column value: {}", index);
+            return Unexpected<Error>(val.error());
+        }
+        auto res = std::get_if<T>(&val.value());
+        if (res == nullptr) {
+            ILIAS_TRACE("sql", "Wrong type of column value: {}", index);
+            return Unexpected<Error>(SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR);
+        }
+        return *res;
     }
-    return *res;
 }
 
 template <typename T>
 auto SqlResult::get(std::string_view name) -> Result<T> {
-    auto val = mImp->get(name);
-    if (!val) {
-        ILIAS_TRACE("sql", "no column value: {}", name);
-        return Unexpected<Error>(val.error());
+    if constexpr (detail::IsSqlView<T>) {
+        return detail::castView<T>(mImp->view(name));
+    }
+    else {
+        auto val = mImp->get(name);
+        if (!val) {
+            ILIAS_TRACE("sql", "no column value: {}", name);
+            return Unexpected<Error>(val.error());
+        }
+        auto res = std::get_if<T>(&val.value());
+        if (res == nullptr) {
+            ILIAS_TRACE("sql", "Wrong type of column value: {}", name);
+            return Unexpected<Error>(SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR);
+        }
+        return *res;
+    }
+}
+
+inline SqlMultiResult &SqlMultiResult::operator=(SqlMultiResult &&other) {
+    if (this != &other) {
+        release();
+        mMysql        = std::move(other.mMysql);
+        mResult       = std::move(other.mResult);
+        mIndex        = other.mIndex;
+        mHasRows      = other.mHasRows;
+        mMore         = std::exchange(other.mMore, false);
+        mRestore      = std::exchange(other.mRestore, false);
+        mAffectedRows = other.mAffectedRows;
+        mInsertId     = other.mInsertId;
+        other.mResult.reset();
+    }
+    return *this;
+}
+
+inline SqlMultiResult::~SqlMultiResult() {
+    release();
+}
+
+// the connection can't be used before every result of the query is read, its next command reads them.
+inline auto SqlMultiResult::release() -> void {
+    mResult.reset();
+    if (mMysql != nullptr && mMore) {
+        mMysql->deferDiscardResults();
+    }
+    mMore = false;
+    restore();
+}
+
+// the connection is left as it was, a later execute() must not run the statements chained to a string.
+inline auto SqlMultiResult::restore() -> void {
+    if (mMysql != nullptr && mRestore) {
+        mMysql->deferMultiStatementsOff();
+    }
+    mRestore = false;
+}
+
+// the counters are read before the result is stored, storing a result set changes them.
+inline auto SqlMultiResult::load() -> IoTask<void> {
+    mHasRows      = mMysql->fieldCount() > 0;
+    mAffectedRows = mMysql->affectedRows();
+    mInsertId     = mMysql->insertId();
+    auto imp      = std::make_unique<detail::SqlQueryResult>(mMysql, SqlResultMode::Buffered, true);
+    auto ret      = co_await imp->getResult();
+    mMore         = mMysql->moreResults();
+    if (!ret) {
+        mMore = false;
+    }
+    if (!mMore) {
+        restore();
+    }
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    if (mHasRows) {
+        mAffectedRows = imp->countRows();
+    }
+    mResult.emplace(SqlResult(std::move(imp)));
+    co_return {};
+}
+
+inline auto SqlMultiResult::nextResult() -> IoTask<bool> {
+    mResult.reset();
+    if (!mMore) {
+        co_return false;
+    }
+    auto ret = co_await (mMysql->nextResult() | ignoreCancellation);
+    if (!ret) {
+        mMore = false;
+        restore();
+        if (ret.error() == SqlError::Code::OK) {
+            co_return false;
+        }
+        co_return Unexpected<Error>(ret.error());
     }
-    auto res = std::get_if<T>(&val.value());
-    if (res == nullptr) {
-        ILIAS_TRACE("sql", "Wrong type of column value: {}", name);
-        return Unexpected<Error>(SqlError::WRONG_TYPE_COLUMN_VALUE_ERROR);
+    ++mIndex;
+    auto loaded = co_await load();
+    if (!loaded) {
+        co_return Unexpected<Error>(loaded.error());
     }
-    return *res;
+    co_return true;
 }
 
 ILIAS_SQL_NS_END
\ No newline at end of file
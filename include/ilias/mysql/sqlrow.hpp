@@ -0,0 +1,161 @@
+/**
+ * @file sqlrow.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief rows copied out of a result, fetched in batches
+ * @version 0.1
+ * @date 2025-02-24
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+#include "detail/global.hpp"
+#include "detail/sqlresultp.hpp"
+#include "sqlmapping.hpp"
+
+ILIAS_SQL_NS_BEGIN
+
+class SqlResult;
+class SqlRowBatch;
+
+/**
+ * @brief A column resolved by name once, then used for every row without a name lookup.
+ *
+ * It is the column of the result set that was current when it was resolved.
+ */
+class SqlColumn {
+public:
+    auto index() const -> size_t { return mIndex; }
+
+private:
+    explicit SqlColumn(size_t index) : mIndex(index) {}
+    size_t mIndex;
+
+    friend class SqlResult;
+};
+
+/**
+ * @brief One row of a SqlRowBatch, valid as long as the batch.
+ */
+class SqlRowView {
+public:
+    auto columnCount() const -> size_t;
+    auto isNull(size_t index) const -> bool;
+    ///> T is any member type SqlMapping supports, std::string_view points into the batch.
+    template <typename T>
+    auto get(size_t index) const -> Result<T>;
+    template <typename T>
+    auto get(SqlColumn column) const -> Result<T>;
+
+private:
+    SqlRowView(const SqlRowBatch *batch, size_t row) : mBatch(batch), mRow(row) {}
+    auto cell(size_t index) const -> Result<detail::SqlCell>;
+
+    const SqlRowBatch *mBatch;
+    size_t             mRow;
+
+    friend class SqlRowBatch;
+};
+
+/**
+ * @brief Up to n rows read by SqlResult::nextBatch(), the values are copied so they stay valid after the result moves
+ * on. All rows of a batch belong to the same result set.
+ */
+class SqlRowBatch {
+public:
+    auto size() const -> size_t { return mRows; }
+    auto empty() const -> bool { return mRows == 0; }
+    auto columnCount() const -> size_t { return mColumns; }
+    auto operator[](size_t row) const -> SqlRowView { return SqlRowView(this, row); }
+
+private:
+    // a copied cell, the text of a Text cell is in mBytes (cell.text is left empty, mBytes may grow).
+    struct Value {
+        detail::SqlCell cell;
+        size_t          offset = 0;
+        size_t          length = 0;
+    };
+
+    auto reset(detail::SqlResultBase &result, size_t rows) -> void;
+    auto append(detail::SqlResultBase &result) -> Result<void>;
+
+    size_t             mRows    = 0;
+    size_t             mColumns = 0;
+    std::vector<Value> mValues; // row major
+    std::vector<char>  mBytes;
+
+    friend class SqlRowView;
+    friend class SqlResult;
+};
+
+inline auto SqlRowView::columnCount() const -> size_t {
+    return mBatch->mColumns;
+}
+
+inline auto SqlRowView::isNull(size_t index) const -> bool {
+    auto cell = this->cell(index);
+    return cell && cell->kind == detail::SqlCell::Null;
+}
+
+inline auto SqlRowView::cell(size_t index) const -> Result<detail::SqlCell> {
+    if (index >= mBatch->mColumns) {
+        return Unexpected<Error>(SqlError::Code::INVALID_INDEX);
+    }
+    auto &value = mBatch->mValues[mRow * mBatch->mColumns + index];
+    auto  cell  = value.cell;
+    if (cell.kind == detail::SqlCell::Text) {
+        cell.text = std::string_view(mBatch->mBytes.data() + value.offset, value.length);
+    }
+    return cell;
+}
+
+template <typename T>
+auto SqlRowView::get(size_t index) const -> Result<T> {
+    auto cell = this->cell(index);
+    if (!cell) {
+        return Unexpected<Error>(cell.error());
+    }
+    T    value {};
+    auto error = detail::fromCell(cell.value(), value);
+    if (!error.isOk()) {
+        return Unexpected<Error>(error.error());
+    }
+    return value;
+}
+
+template <typename T>
+auto SqlRowView::get(SqlColumn column) const -> Result<T> {
+    return get<T>(column.index());
+}
+
+inline auto SqlRowBatch::reset(detail::SqlResultBase &result, size_t rows) -> void {
+    mRows    = 0;
+    mColumns = result.columnCount();
+    mValues.clear();
+    mValues.reserve(mColumns * std::min<size_t>(rows, 1024));
+    mBytes.clear();
+}
+
+// copy the current row of the result.
+inline auto SqlRowBatch::append(detail::SqlResultBase &result) -> Result<void> {
+    for (size_t i = 0; i < mColumns; ++i) {
+        auto cell = result.cell(i);
+        if (!cell) {
+            mValues.resize(mRows * mColumns);
+            return Unexpected<Error>(cell.error());
+        }
+        auto text  = cell->text;
+        cell->text = {};
+        mValues.push_back(Value {cell.value(), mBytes.size(), text.size()});
+        mBytes.insert(mBytes.end(), text.begin(), text.end());
+    }
+    ++mRows;
+    return {};
+}
+
+ILIAS_SQL_NS_END
@@ -0,0 +1,474 @@
+/**
+ * @file sqlstatement.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief prepared statement handle, prepare once and execute many times
+ * @version 0.1
+ * @date 2025-02-14
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <ilias/io/context.hpp>
+#include <ilias/io/method.hpp>
+#include <ilias/io/system_error.hpp>
+#include <mariadb/mysql.h>
+#include <mariadb/mysqld_error.h>
+#include <cstring>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "detail/global.hpp"
+#include "detail/mysql.hpp"
+#include "detail/sqlbulk.hpp"
+#include "detail/sqllongdata.hpp"
+#include "detail/sqlparams.hpp"
+#include "detail/sqlresultp.hpp"
+#include "sqldatabase.hpp"
+#include "sqlresult.hpp"
+
+ILIAS_SQL_NS_BEGIN
+
+/**
+ * @brief A statement that is prepared once and executed many times.
+ *
+ * Every parameter owns a fixed slot the MYSQL_BIND points to, setting a value of the same type only writes the slot.
+ * mysql_stmt_bind_param() is called again only when the bind layout changed (a type change or a moved buffer), so a
+ * hot statement executed with new values does no per call setup.
+ * The SqlResult of an execute() must be destroyed before the next execute().
+ */
+class SqlPreparedStatement {
+public:
+    SqlPreparedStatement(SqlDatabase &db);
+    ~SqlPreparedStatement();
+
+    SqlPreparedStatement(SqlPreparedStatement &&other) noexcept;
+    SqlPreparedStatement &operator=(SqlPreparedStatement &&other) noexcept;
+
+    SqlPreparedStatement(const SqlPreparedStatement &)            = delete;
+    SqlPreparedStatement &operator=(const SqlPreparedStatement &) = delete;
+
+    [[nodiscard("Don't forget to use co_await")]]
+    auto prepare(std::string_view query) -> IoTask<void>;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto execute(SqlResultMode mode = SqlResultMode::Buffered) -> IoTask<SqlResult>;
+    ///> execute for the counters only, no result is allocated for a statement without rows (rows are discarded).
+    [[nodiscard("Don't forget to use co_await")]]
+    auto exec() -> IoTask<SqlExecInfo>;
+    ///> execute the prepared statement once per row (a std::tuple of parameter values, std::optional for NULL) in a
+    ///> single bulk round trip, return the affected rows. The rows are only referenced during the call.
+    template <typename Row>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto executeBatch(std::span<const Row> rows) -> IoTask<uint64_t>;
+    template <typename Rows>
+        requires std::ranges::contiguous_range<const Rows &>
+    [[nodiscard("Don't forget to use co_await")]]
+    auto executeBatch(const Rows &rows) -> IoTask<uint64_t> {
+        return executeBatch(std::span<const std::ranges::range_value_t<Rows>>(rows));
+    }
+    auto paramCount() const -> std::size_t;
+    auto isPrepared() const -> bool;
+
+    ///> set TINYINT
+    auto set(int index, signed char value) -> SqlError;
+    ///> set SMALLINT
+    auto set(int index, short int value) -> SqlError;
+    ///> set INT
+    auto set(int index, int value) -> SqlError;
+    ///> set BIGINT / LONGLONG
+    auto set(int index, long long int value) -> SqlError;
+    ///> set FLOAT
+    auto set(int index, float value) -> SqlError;
+    ///> set DOUBLE
+    auto set(int index, double value) -> SqlError;
+    ///> set TEXT, CHAR, VARCHAR, the string is copied into the parameter slot.
+    auto set(int index, std::string_view value) -> SqlError;
+    ///> set TIME, DATE, DATETIME, TIMESTAMP
+    auto set(int index, const SqlDate &value) -> SqlError;
+    ///> set NULL
+    auto set(int index, std::nullptr_t) -> SqlError;
+    ///> set value
+    template <typename T>
+    auto set(const std::string &name, const T &value) -> SqlError;
+
+    ///> set TEXT, CHAR, VARCHAR, this api will not copy, Please ensure that the data is valid during execute.
+    auto setView(int index, std::string_view value) -> SqlError;
+    ///> set BLOB, BINARY, VARBINARY, this api will not copy, Please ensure that the data is valid during execute.
+    auto setView(int index, std::span<const std::byte> value) -> SqlError;
+    ///> set valueView, this api will not copy, Please ensure that the data is valid during execute.
+    template <typename T>
+    auto setView(const std::string &name, const T &value) -> SqlError;
+    ///> set BLOB, TEXT from the chunks of source, sent to the server by the next execute before the statement runs.
+    auto setStream(int index, SqlChunkSource source) -> SqlError;
+    ///> set BLOB, TEXT in chunkSize pieces (a mmap'd file...), this api will not copy, the data is used during execute.
+    auto setStream(int index, std::span<const std::byte> data, size_t chunkSize = 1024 * 1024) -> SqlError;
+    auto setStream(const std::string &name, SqlChunkSource source) -> SqlError;
+
+private:
+    struct Param {
+        union {
+            signed char   tiny;
+            short int     small;
+            int           normal;
+            long long int big;
+            float         single;
+            double        dbl;
+        } number             = {};
+        MYSQL_TIME    time   = {};
+        std::string   text   = {}; // owned copy for set(std::string), its capacity is reused.
+        unsigned long length = 0;
+        my_bool       isNull = 1;
+    };
+
+    auto checkIndex(int index) const -> SqlError;
+    auto bindParams() -> Result<void>;
+    [[nodiscard("Don't forget to use co_await")]]
+    auto sendParams() -> IoTask<void>;
+    auto setLayout(int index, enum_field_types type, void *buffer) -> void;
+    auto closeStmt() -> void;
+
+    std::shared_ptr<detail::MySql>       mMysql;
+    MYSQL_STMT                          *mStmt = nullptr;
+    std::vector<MYSQL_BIND>              mBinds;
+    std::vector<Param>                   mParams;
+    std::unordered_map<std::string, int> mIndexs;
+    detail::SqlLongData                  mLongData;
+    bool                                 mRebind = true; // bind layout changed since last mysql_stmt_bind_param.
+};
+
+inline SqlPreparedStatement::SqlPreparedStatement(SqlDatabase &db) : mMysql(db.mysql()) {
+}
+
+inline SqlPreparedStatement::~SqlPreparedStatement() {
+    closeStmt();
+}
+
+// moving the vectors keeps their storage, so the binds still point at the right params.
+inline SqlPreparedStatement::SqlPreparedStatement(SqlPreparedStatement &&other) noexcept
+    : mMysql(std::move(other.mMysql)), mStmt(other.mStmt), mBinds(std::move(other.mBinds)),
+      mParams(std::move(other.mParams)), mIndexs(std::move(other.mIndexs)), mLongData(std::move(other.mLongData)),
+      mRebind(other.mRebind) {
+    other.mStmt = nullptr;
+}
+
+inline SqlPreparedStatement &SqlPreparedStatement::operator=(SqlPreparedStatement &&other) noexcept {
+    if (this != &other) {
+        closeStmt();
+        mMysql      = std::move(other.mMysql);
+        mStmt       = other.mStmt;
+        mBinds      = std::move(other.mBinds);
+        mParams     = std::move(other.mParams);
+        mIndexs     = std::move(other.mIndexs);
+        mLongData   = std::move(other.mLongData);
+        mRebind     = other.mRebind;
+        other.mStmt = nullptr;
+    }
+    return *this;
+}
+
+// a result of the statement may still have to reset it, the connection closes it after that.
+inline auto SqlPreparedStatement::closeStmt() -> void {
+    if (mStmt != nullptr) {
+        mMysql->deferStmtClose(mStmt);
+        mStmt = nullptr;
+    }
+}
+
+inline auto SqlPreparedStatement::prepare(std::string_view query) -> IoTask<void> {
+    ILIAS_ASSERT(mMysql != nullptr);
+    closeStmt();
+    auto queryp = detail::rewriteNamedParams(query, mIndexs);
+    mStmt       = mMysql->stmtInit();
+    if (mStmt == nullptr) {
+        co_return Unexpected<Error>(mMysql->lastError().error());
+    }
+    ILIAS_TRACE("sql", "prepare statement :{}", queryp);
+    auto ret = co_await mMysql->stmtPrepare(mStmt, queryp);
+    if (!ret) {
+        closeStmt();
+        co_return Unexpected<Error>(ret.error());
+    }
+    auto count = mysql_stmt_param_count(mStmt);
+    mParams.clear();
+    mParams.resize(count);
+    mLongData.clear();
+    mBinds.resize(count);
+    memset(mBinds.data(), 0, sizeof(MYSQL_BIND) * mBinds.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        mBinds[i].buffer_type = MYSQL_TYPE_NULL;
+        mBinds[i].length      = &mParams[i].length;
+        mBinds[i].is_null     = &mParams[i].isNull;
+    }
+    mRebind = true;
+    co_return {};
+}
+
+inline auto SqlPreparedStatement::execute(SqlResultMode mode) -> IoTask<SqlResult> {
+    if (mStmt == nullptr) {
+        co_return Unexpected<Error>(SqlError::Code::NOT_PREPARED);
+    }
+    if (auto sent = co_await sendParams(); !sent) {
+        co_return Unexpected<Error>(sent.error());
+    }
+    detail::applyResultMode(mStmt, mode);
+    auto ret = co_await mMysql->stmtExecute(mStmt);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    auto sqlResult = std::make_unique<detail::SqlStmtResult>(mMysql, mStmt, true, mode);
+    auto ret1      = co_await sqlResult->getResult();
+    if (!ret1) {
+        co_return Unexpected<Error>(ret1.error());
+    }
+    co_return SqlResult(std::move(sqlResult));
+}
+
+inline auto SqlPreparedStatement::bindParams() -> Result<void> {
+    if (mRebind && !mBinds.empty()) {
+        if (mysql_stmt_bind_param(mStmt, mBinds.data()) != 0) {
+            ILIAS_ERROR("sql", "stmt bind failed. (error {}:{})", mysql_stmt_errno(mStmt), mysql_stmt_error(mStmt));
+            return Unexpected<Error>((SqlError::Code)mysql_stmt_errno(mStmt));
+        }
+    }
+    mRebind = false;
+    return {};
+}
+
+// the long data is sent after the binds, mysql_stmt_send_long_data needs the parameter types.
+inline auto SqlPreparedStatement::sendParams() -> IoTask<void> {
+    if (auto bound = bindParams(); !bound) {
+        mLongData.clear();
+        co_return Unexpected<Error>(bound.error());
+    }
+    co_return co_await mLongData.send(*mMysql, mStmt);
+}
+
+inline auto SqlPreparedStatement::exec() -> IoTask<SqlExecInfo> {
+    if (mStmt == nullptr) {
+        co_return Unexpected<Error>(SqlError::Code::NOT_PREPARED);
+    }
+    if (auto sent = co_await sendParams(); !sent) {
+        co_return Unexpected<Error>(sent.error());
+    }
+    detail::applyResultMode(mStmt, SqlResultMode::Buffered);
+    auto ret = co_await mMysql->stmtExecute(mStmt);
+    if (!ret) {
+        co_return Unexpected<Error>(ret.error());
+    }
+    SqlExecInfo info {mysql_stmt_affected_rows(mStmt), mysql_stmt_insert_id(mStmt), mMysql->warningCount()};
+    if (mysql_stmt_field_count(mStmt) > 0) {
+        detail::SqlStmtResult result(mMysql, mStmt, true, SqlResultMode::Buffered);
+        ret = co_await result.getResult();
+        if (!ret) {
+            co_return Unexpected<Error>(ret.error());
+        }
+        info.affectedRows = result.countRows();
+    }
+    co_return info;
+}
+
+// the bulk binds replace the slot binds on the statement, the next execute() binds the slots again.
+template <typename Row>
+inline auto SqlPreparedStatement::executeBatch(std::span<const Row> rows) -> IoTask<uint64_t> {
+    if (mStmt == nullptr) {
+        co_return Unexpected<Error>(SqlError::Code::NOT_PREPARED);
+    }
+    detail::SqlBulkBinder binder;
+    binder.bind(rows);
+    mRebind = true;
+    co_return co_await detail::executeBulk(*mMysql, mStmt, binder);
+}
+
+inline auto SqlPreparedStatement::paramCount() const -> std::size_t {
+    return mParams.size();
+}
+
+inline auto SqlPreparedStatement::isPrepared() const -> bool {
+    return mStmt != nullptr;
+}
+
+inline auto SqlPreparedStatement::checkIndex(int index) const -> SqlError {
+    if (mStmt == nullptr) {
+        return SqlError::NOT_PREPARED;
+    }
+    if (index < 0 || index >= (int)mBinds.size()) {
+        return SqlError::INVALID_INDEX;
+    }
+    return SqlError::OK;
+}
+
+// only a different type or buffer needs a new mysql_stmt_bind_param, values are read through the pointers.
+// the length is read through its pointer as well, a string of a new size still reuses the bind.
+inline auto SqlPreparedStatement::setLayout(int index, enum_field_types type, void *buffer) -> void {
+    auto &bind            = mBinds[index];
+    mParams[index].isNull = 0;
+    if (bind.buffer_type == type && bind.buffer == buffer) {
+        return;
+    }
+    bind.buffer_type = type;
+    bind.buffer      = buffer;
+    mRebind          = true;
+}
+
+inline auto SqlPreparedStatement::set(int index, signed char value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    mParams[index].number.tiny = value;
+    setLayout(index, MYSQL_TYPE_TINY, &mParams[index].number);
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::set(int index, short int value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    mParams[index].number.small = value;
+    setLayout(index, MYSQL_TYPE_SHORT, &mParams[index].number);
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::set(int index, int value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    mParams[index].number.normal = value;
+    setLayout(index, MYSQL_TYPE_LONG, &mParams[index].number);
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::set(int index, long long int value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    mParams[index].number.big = value;
+    setLayout(index, MYSQL_TYPE_LONGLONG, &mParams[index].number);
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::set(int index, float value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    mParams[index].number.single = value;
+    setLayout(index, MYSQL_TYPE_FLOAT, &mParams[index].number);
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::set(int index, double value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    mParams[index].number.dbl = value;
+    setLayout(index, MYSQL_TYPE_DOUBLE, &mParams[index].number);
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::set(int index, std::string_view value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    auto &param = mParams[index];
+    if (param.text != value) {
+        // assign keeps the buffer while the capacity is enough.
+        param.text.assign(value);
+    }
+    param.length = (unsigned long)param.text.size();
+    setLayout(index, MYSQL_TYPE_STRING, param.text.data());
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::set(int index, const SqlDate &value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    enum_field_types type;
+    switch (value.time.time_type) {
+        case MYSQL_TIMESTAMP_DATE:
+            type = MYSQL_TYPE_DATE;
+            break;
+        case MYSQL_TIMESTAMP_DATETIME:
+            type = MYSQL_TYPE_DATETIME;
+            break;
+        case MYSQL_TIMESTAMP_TIME:
+            type = MYSQL_TYPE_TIME;
+            break;
+        default:
+            return SqlError::INVALID_PARAMETER;
+    }
+    mParams[index].time = value.time;
+    setLayout(index, type, &mParams[index].time);
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::set(int index, std::nullptr_t) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    // is_null is read through its pointer, no rebind needed.
+    mParams[index].isNull = 1;
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::setView(int index, std::string_view value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    mParams[index].length = (unsigned long)value.size();
+    setLayout(index, MYSQL_TYPE_STRING, const_cast<char *>(value.data()));
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::setView(int index, std::span<const std::byte> value) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    mParams[index].length = (unsigned long)value.size();
+    setLayout(index, MYSQL_TYPE_BLOB, const_cast<std::byte *>(value.data()));
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::setStream(int index, SqlChunkSource source) -> SqlError {
+    if (auto err = checkIndex(index); !err.isOk()) {
+        return err;
+    }
+    mParams[index].length = 0;
+    setLayout(index, MYSQL_TYPE_BLOB, nullptr);
+    mLongData.add(index, std::move(source));
+    return SqlError::OK;
+}
+
+inline auto SqlPreparedStatement::setStream(int index, std::span<const std::byte> data, size_t chunkSize) -> SqlError {
+    return setStream(index, chunksOf(data, chunkSize));
+}
+
+inline auto SqlPreparedStatement::setStream(const std::string &name, SqlChunkSource source) -> SqlError {
+    auto index = mIndexs.find(name);
+    if (index == mIndexs.end()) {
+        return SqlError::INVALID_INDEX;
+    }
+    return setStream(index->second, std::move(source));
+}
+
+template <typename T>
+inline auto SqlPreparedStatement::set(const std::string &name, const T &value) -> SqlError {
+    auto index = mIndexs.find(name);
+    if (index == mIndexs.end()) {
+        return SqlError::INVALID_INDEX;
+    }
+    return set(index->second, value);
+}
+
+template <typename T>
+inline auto SqlPreparedStatement::setView(const std::string &name, const T &value) -> SqlError {
+    auto index = mIndexs.find(name);
+    if (index == mIndexs.end()) {
+        return SqlError::INVALID_INDEX;
+    }
+    return setView(index->second, value);
+}
+
+ILIAS_SQL_NS_END
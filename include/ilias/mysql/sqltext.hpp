@@ -0,0 +1,320 @@
+/**
+ * @file sqltext.hpp
+ * @author llhsdmd (llhsdmd@gmail.com)
+ * @brief format rows as CSV or JSON Lines
+ * @version 0.1
+ * @date 2025-02-27
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <mariadb/mysql.h>
+
+#include "detail/global.hpp"
+#include "detail/sqlresultp.hpp"
+#include "sqlcolumns.hpp"
+
+ILIAS_SQL_NS_BEGIN
+
+enum class SqlTextFormat : uint8_t {
+    Csv,       ///> RFC 4180, a field is quoted only when it has to be.
+    JsonLines, ///> one object per row, numbers unquoted, NULL and non-finite reals are null, binary is base64.
+};
+
+struct SqlTextOptions {
+    SqlTextFormat    format    = SqlTextFormat::Csv;
+    char             delimiter = ',';  ///> csv field delimiter.
+    bool             header    = true; ///> csv line of column names first.
+    std::string_view null      = "";   ///> csv text of a NULL.
+    size_t           batchRows = 256;  ///> rows formatted between two writes to the sink.
+};
+
+namespace detail {
+
+// true for a valid JSON number, a text protocol number is sent as is unless it is not one (ZEROFILL, "nan"...).
+inline auto isJsonNumber(std::string_view text) -> bool {
+    auto p      = text.data();
+    auto end    = p + text.size();
+    auto digits = [&]() {
+        auto begin = p;
+        while (p != end && *p >= '0' && *p <= '9') {
+            ++p;
+        }
+        return p != begin;
+    };
+    if (p != end && *p == '-') {
+        ++p;
+    }
+    if (p != end && *p == '0') {
+        ++p;
+    }
+    else if (!digits()) {
+        return false;
+    }
+    if (p != end && *p == '.') {
+        ++p;
+        if (!digits()) {
+            return false;
+        }
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        if (p != end && (*p == '+' || *p == '-')) {
+            ++p;
+        }
+        if (!digits()) {
+            return false;
+        }
+    }
+    return p == end;
+}
+
+inline auto isNumericType(enum_field_types type) -> bool {
+    switch (type) {
+        case MYSQL_TYPE_TINY:
+        case MYSQL_TYPE_SHORT:
+        case MYSQL_TYPE_LONG:
+        case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_LONGLONG:
+        case MYSQL_TYPE_YEAR:
+        case MYSQL_TYPE_FLOAT:
+        case MYSQL_TYPE_DOUBLE:
+        case MYSQL_TYPE_DECIMAL:
+        case MYSQL_TYPE_NEWDECIMAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Formats rows into one reusable buffer, straight from the cells of the current row: the text protocol row
+ * bytes or the bound statement buffers, nothing is allocated per cell.
+ *
+ * It is the rows type of SqlResult::collect(), clear() it before each batch then write bytes() out.
+ */
+class SqlTextEncoder {
+public:
+    explicit SqlTextEncoder(const SqlTextOptions &options) : mOptions(options) {}
+
+    auto size() const -> size_t { return mRows; }
+    auto bytes() const -> std::span<const std::byte> { return std::as_bytes(std::span(mBuffer)); }
+    auto clear() -> void;
+    ///> the csv line of column names.
+    auto header(SqlResultBase &result) -> void;
+    auto reset(SqlResultBase &result, size_t rows) -> void;
+    auto append(SqlResultBase &result) -> Result<void>;
+
+private:
+    auto appendCsv(std::string_view text) -> void;
+    static auto appendJson(std::vector<char> &out, std::string_view text) -> void;
+    auto appendBase64(std::string_view bytes) -> void;
+    auto appendCell(const SqlCell &cell, bool binary) -> void;
+
+    SqlTextOptions      mOptions;
+    size_t              mRows = 0;
+    std::vector<char>   mBuffer;
+    std::vector<char>   mKeys;       // json: "name": of every column, escaped once per batch
+    std::vector<size_t> mKeyOffsets; // json: column i key is mKeys[mKeyOffsets[i], mKeyOffsets[i + 1])
+    std::vector<bool>   mBinary;     // json: column i is raw bytes (binary charset), not UTF-8 text
+};
+
+inline auto SqlTextEncoder::clear() -> void {
+    mRows = 0;
+    mBuffer.clear();
+}
+
+inline auto SqlTextEncoder::header(SqlResultBase &result) -> void {
+    if (mOptions.format != SqlTextFormat::Csv || !mOptions.header || result.columnCount() == 0) {
+        return;
+    }
+    for (size_t i = 0; i < result.columnCount(); ++i) {
+        if (i != 0) {
+            mBuffer.push_back(mOptions.delimiter);
+        }
+        auto field = result.field(i);
+        appendCsv(std::string_view(field->name, field->name_length));
+    }
+    mBuffer.push_back('\n');
+}
+
+inline auto SqlTextEncoder::reset(SqlResultBase &result, size_t) -> void {
+    if (mOptions.format != SqlTextFormat::JsonLines) {
+        return;
+    }
+    mKeys.clear();
+    mKeyOffsets.clear();
+    mBinary.clear();
+    for (size_t i = 0; i < result.columnCount(); ++i) {
+        auto field = result.field(i);
+        mBinary.push_back(field->charsetnr == 63 && isByteType(field->type));
+        mKeyOffsets.push_back(mKeys.size());
+        appendJson(mKeys, std::string_view(field->name, field->name_length));
+        mKeys.push_back(':');
+    }
+    mKeyOffsets.push_back(mKeys.size());
+}
+
+inline auto SqlTextEncoder::appendCsv(std::string_view text) -> void {
+    if (text.find_first_of(std::string_view {"\"\r\n", 3}) == std::string_view::npos &&
+        text.find(mOptions.delimiter) == std::string_view::npos) {
+        mBuffer.insert(mBuffer.end(), text.begin(), text.end());
+        return;
+    }
+    mBuffer.push_back('"');
+    for (auto c : text) {
+        if (c == '"') {
+            mBuffer.push_back('"');
+        }
+        mBuffer.push_back(c);
+    }
+    mBuffer.push_back('"');
+}
+
+inline auto SqlTextEncoder::appendJson(std::vector<char> &out, std::string_view text) -> void {
+    static constexpr char kHex[] = "0123456789abcdef";
+    out.push_back('"');
+    auto plain = text.begin();
+    for (auto iter = text.begin(); iter != text.end(); ++iter) {
+        auto c = static_cast<unsigned char>(*iter);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.insert(out.end(), plain, iter);
+        plain = iter + 1;
+        out.push_back('\\');
+        switch (c) {
+            case '"':
+            case '\\':
+                out.push_back(char(c));
+                break;
+            case '\n':
+                out.push_back('n');
+                break;
+            case '\r':
+                out.push_back('r');
+                break;
+            case '\t':
+                out.push_back('t');
+                break;
+            default:
+                out.insert(out.end(), {'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]});
+                break;
+        }
+    }
+    out.insert(out.end(), plain, text.end());
+    out.push_back('"');
+}
+
+// a JSON string has to be UTF-8, bytes are written as a base64 string.
+inline auto SqlTextEncoder::appendBase64(std::string_view bytes) -> void {
+    static constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    mBuffer.push_back('"');
+    size_t i = 0;
+    for (; i + 3 <= bytes.size(); i += 3) {
+        uint32_t triple = (uint8_t(bytes[i]) << 16) | (uint8_t(bytes[i + 1]) << 8) | uint8_t(bytes[i + 2]);
+        mBuffer.insert(mBuffer.end(), {kAlphabet[triple >> 18], kAlphabet[(triple >> 12) & 0x3F],
+                                       kAlphabet[(triple >> 6) & 0x3F], kAlphabet[triple & 0x3F]});
+    }
+    if (i + 1 == bytes.size()) {
+        uint32_t triple = uint8_t(bytes[i]) << 16;
+        mBuffer.insert(mBuffer.end(), {kAlphabet[triple >> 18], kAlphabet[(triple >> 12) & 0x3F], '=', '='});
+    }
+    else if (i + 2 == bytes.size()) {
+        uint32_t triple = (uint8_t(bytes[i]) << 16) | (uint8_t(bytes[i + 1]) << 8);
+        mBuffer.insert(mBuffer.end(), {kAlphabet[triple >> 18], kAlphabet[(triple >> 12) & 0x3F],
+                                       kAlphabet[(triple >> 6) & 0x3F], '='});
+    }
+    mBuffer.push_back('"');
+}
+
+inline auto SqlTextEncoder::appendCell(const SqlCell &cell, bool binary) -> void {
+    bool json = mOptions.format == SqlTextFormat::JsonLines;
+    switch (cell.kind) {
+        case SqlCell::Null:
+            if (json) {
+                mBuffer.insert(mBuffer.end(), {'n', 'u', 'l', 'l'});
+            }
+            else {
+                appendCsv(mOptions.null);
+            }
+            break;
+        case SqlCell::Text:
+            if (!json) {
+                appendCsv(cell.text);
+            }
+            else if (isNumericType(cell.type) && isJsonNumber(cell.text)) {
+                mBuffer.insert(mBuffer.end(), cell.text.begin(), cell.text.end());
+            }
+            else if (binary) {
+                appendBase64(cell.text);
+            }
+            else {
+                appendJson(mBuffer, cell.text);
+            }
+            break;
+        case SqlCell::Integer:
+        case SqlCell::Real: {
+            if (json && cell.kind == SqlCell::Real && !std::isfinite(cell.real)) {
+                // inf and nan are no JSON numbers.
+                mBuffer.insert(mBuffer.end(), {'n', 'u', 'l', 'l'});
+                break;
+            }
+            char buffer[32];
+            auto end = buffer;
+            if (cell.kind == SqlCell::Real) {
+                end = std::to_chars(buffer, buffer + sizeof(buffer), cell.real).ptr;
+            }
+            else if (cell.isUnsigned) {
+                end = std::to_chars(buffer, buffer + sizeof(buffer), (uint64_t)cell.integer).ptr;
+            }
+            else {
+                end = std::to_chars(buffer, buffer + sizeof(buffer), cell.integer).ptr;
+            }
+            mBuffer.insert(mBuffer.end(), buffer, end);
+            break;
+        }
+    }
+}
+
+inline auto SqlTextEncoder::append(SqlResultBase &result) -> Result<void> {
+    bool json  = mOptions.format == SqlTextFormat::JsonLines;
+    auto count = result.columnCount();
+    auto size  = mBuffer.size();
+    if (json) {
+        mBuffer.push_back('{');
+    }
+    for (size_t i = 0; i < count; ++i) {
+        auto cell = result.cell(i);
+        if (!cell) {
+            mBuffer.resize(size);
+            return Unexpected<Error>(cell.error());
+        }
+        if (i != 0) {
+            mBuffer.push_back(json ? ',' : mOptions.delimiter);
+        }
+        if (json) {
+            mBuffer.insert(mBuffer.end(), mKeys.begin() + mKeyOffsets[i], mKeys.begin() + mKeyOffsets[i + 1]);
+        }
+        appendCell(cell.value(), json && mBinary[i]);
+    }
+    if (json) {
+        mBuffer.push_back('}');
+    }
+    mBuffer.push_back('\n');
+    ++mRows;
+    return {};
+}
+
+} // namespace detail
+
+ILIAS_SQL_NS_END
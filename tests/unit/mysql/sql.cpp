@@ -1,8 +1,13 @@
 #include <gtest/gtest.h>
 
 #include <ilias/platform.hpp>
+#include <ilias/task/when_all.hpp>
+#include "ilias/mysql/sqlarrow.hpp"
+#include "ilias/mysql/sqlpipeline.hpp"
+#include "ilias/mysql/sqlpool.hpp"
 #include "ilias/mysql/sqlquery.hpp"
 #include "ilias/mysql/sqlresult.hpp"
+#include "ilias/mysql/sqlstatement.hpp"
 
 ILIAS_SQL_USE_NAMESPACE;
 
@@ -17,6 +22,14 @@ struct Person {
     int                    val2;
 };
 
+template <>
+struct ILIAS_SQL_COMPLETE_NAMESPACE::SqlMapping<Person> {
+    static constexpr auto fields =
+        std::make_tuple(ILIAS_SQL_FIELD(Person, id), ILIAS_SQL_FIELD(Person, name), ILIAS_SQL_FIELD(Person, age),
+                        ILIAS_SQL_FIELD(Person, email), ILIAS_SQL_FIELD(Person, born),
+                        ILIAS_SQL_FIELD(Person, promise), ILIAS_SQL_FIELD(Person, val1), ILIAS_SQL_FIELD(Person, val2));
+};
+
 ILIAS_NAMESPACE::Task<void> test() {
     SqlDatabase db;
     db.setHost("127.0.0.1");
@@ -151,6 +164,24 @@ ILIAS_NAMESPACE::Task<void> test() {
                    born.toString(), (int)val1, val2, str);
     }
 
+    // the same rows decoded straight into Person.
+    ret1 = co_await query.prepare("SELECT * FROM test_table WHERE id>:id");
+    EXPECT_TRUE(ret1.has_value());
+    query.set("id", 1);
+    ret = co_await query.execute();
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    auto mapped = co_await ret.value().fetchAll<std::vector<Person>>();
+    EXPECT_TRUE(mapped.has_value());
+    EXPECT_EQ(mapped.value_or(std::vector<Person> {}).size(), persons.size() - 1);
+    for (auto &person : mapped.value_or(std::vector<Person> {})) {
+        EXPECT_EQ(person.name, persons[person.id - 1].name);
+        EXPECT_EQ(person.promise, persons[person.id - 1].promise);
+        EXPECT_EQ(person.val2, persons[person.id - 1].val2);
+    }
+
     // co_await mysql.autoCommit(false);
     co_return;
 }
@@ -159,10 +190,772 @@ TEST(SQL, test) {
     ilias_wait test();
 }
 
+ILIAS_NAMESPACE::Task<void> poolTest() {
+    SqlDatabase db;
+    db.setHost("127.0.0.1");
+    db.setUserName("root");
+    db.setPassword("123456");
+    db.setPort(3306);
+    SqlConnectionPool pool(db, 2, [](SqlDatabase &conn) { conn.setOption(sqlopt::InitCommand("SET NAMES 'utf8mb4'")); });
+
+    auto warm = co_await pool.warmUp(1);
+    EXPECT_TRUE(warm.has_value());
+    if (!warm.has_value()) {
+        co_return;
+    }
+    EXPECT_EQ(pool.size(), 1);
+    {
+        auto conn1 = co_await pool.acquire(std::chrono::seconds(1));
+        auto conn2 = co_await pool.acquire(std::chrono::seconds(1));
+        EXPECT_TRUE(conn1.has_value() && conn2.has_value());
+        if (!conn1.has_value() || !conn2.has_value()) {
+            co_return;
+        }
+        EXPECT_EQ(pool.idleCount(), 0);
+        // pool is exhausted, the third acquire should time out.
+        auto conn3 = co_await pool.acquire(std::chrono::milliseconds(50));
+        EXPECT_FALSE(conn3.has_value());
+
+        SqlQuery query(*conn1.value());
+        auto     ret = co_await query.execute("SELECT 1");
+        EXPECT_TRUE(ret.has_value());
+    }
+    EXPECT_EQ(pool.idleCount(), 2);
+    // recycled with reset connection, no new handshake.
+    auto conn = co_await pool.acquire();
+    EXPECT_TRUE(conn.has_value());
+    EXPECT_EQ(pool.size(), 2);
+}
+
+TEST(SQL, pool) {
+    ilias_wait poolTest();
+}
+
+ILIAS_NAMESPACE::Task<void> raceTest() {
+    SqlDatabase db;
+    // nothing listens on the first host, its refusal starts the next one before the stagger ends.
+    db.setHost("127.0.0.1");
+    db.setPort(1);
+    db.addHost("127.0.0.1", 3306);
+    db.setConnectStagger(std::chrono::seconds(5));
+    db.setUserName("root");
+    db.setPassword("123456");
+    auto begin = std::chrono::steady_clock::now();
+    auto ret   = co_await db.open();
+    EXPECT_TRUE(ret.has_value());
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(5));
+    if (!ret.has_value()) {
+        co_return;
+    }
+    SqlQuery query(db);
+    auto     result = co_await query.execute("SELECT 1");
+    EXPECT_TRUE(result.has_value());
+}
+
+TEST(SQL, race) {
+    ilias_wait raceTest();
+}
+
+ILIAS_NAMESPACE::Task<void> statementTest() {
+    SqlDatabase db;
+    db.setHost("127.0.0.1");
+    db.setUserName("root");
+    db.setPassword("123456");
+    db.setPort(3306);
+    auto ret1 = co_await db.open();
+    EXPECT_TRUE(ret1.has_value());
+    if (!ret1.has_value()) {
+        co_return;
+    }
+    SqlPreparedStatement stmt(db);
+    ret1 = co_await stmt.prepare("SELECT CAST(:value AS SIGNED) + 1 AS plus, CAST(:name AS CHAR) AS name");
+    EXPECT_TRUE(ret1.has_value());
+    if (!ret1.has_value()) {
+        co_return;
+    }
+    EXPECT_EQ(stmt.paramCount(), 2);
+    // prepared once, executed many times with only the values changing.
+    for (long long int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(stmt.set("value", i).isOk());
+        EXPECT_TRUE(stmt.set("name", std::string_view(i % 2 ? "odd" : "even")).isOk());
+        auto ret = co_await stmt.execute();
+        EXPECT_TRUE(ret.has_value());
+        if (!ret.has_value()) {
+            co_return;
+        }
+        auto result = std::move(ret.value());
+        EXPECT_TRUE(co_await result.next());
+        EXPECT_EQ(result.get<int64_t>("plus").value_or(-1), i + 1);
+        auto plus = result.column("plus");
+        EXPECT_TRUE(plus.has_value());
+        EXPECT_EQ(result.get<int64_t>(plus.value()).value_or(-1), i + 1);
+        EXPECT_EQ(result.get<std::string>("name").value_or(""), i % 2 ? "odd" : "even");
+        EXPECT_EQ(result.get<std::string_view>("name").value_or(""), i % 2 ? "odd" : "even");
+        EXPECT_EQ(result.getView(1).value_or("").size(), i % 2 ? 3 : 4);
+    }
+    // a parameter streamed in chunks.
+    std::vector<std::byte> blob(3 * 1024 * 1024 + 7, std::byte {'x'});
+    ret1 = co_await stmt.prepare("SELECT LENGTH(:blob) AS size");
+    EXPECT_TRUE(ret1.has_value());
+    if (!ret1.has_value()) {
+        co_return;
+    }
+    EXPECT_TRUE(stmt.setStream(0, blob, 1024 * 1024).isOk());
+    {
+        auto streamed = co_await stmt.execute();
+        EXPECT_TRUE(streamed.has_value());
+        if (streamed.has_value()) {
+            EXPECT_TRUE(co_await streamed->next());
+            EXPECT_EQ(streamed->get<int64_t>("size").value_or(-1), (int64_t)blob.size());
+        }
+    }
+    // a source failing halfway leaves none of its chunks to the next execute.
+    int  pulls  = 0;
+    auto broken = [&]() -> ILIAS_NAMESPACE::IoTask<std::span<const std::byte>> {
+        if (pulls++ == 0) {
+            co_return std::span<const std::byte>(blob).first(1024);
+        }
+        co_return ILIAS_NAMESPACE::Unexpected<ILIAS_NAMESPACE::Error>(ILIAS_NAMESPACE::Error::Unknown);
+    };
+    EXPECT_TRUE(stmt.setStream(0, broken).isOk());
+    {
+        auto failed = co_await stmt.execute();
+        EXPECT_FALSE(failed.has_value());
+    }
+    EXPECT_TRUE(stmt.setStream(0, std::span<const std::byte>(blob).first(5)).isOk());
+    {
+        auto streamed = co_await stmt.execute();
+        EXPECT_TRUE(streamed.has_value());
+        if (streamed.has_value()) {
+            EXPECT_TRUE(co_await streamed->next());
+            EXPECT_EQ(streamed->get<int64_t>("size").value_or(-1), 5);
+        }
+    }
+    // and read back in chunks.
+    ret1 = co_await stmt.prepare("SELECT :blob AS data");
+    EXPECT_TRUE(ret1.has_value());
+    if (!ret1.has_value()) {
+        co_return;
+    }
+    EXPECT_TRUE(stmt.setStream(0, blob).isOk());
+    auto chunked = co_await stmt.execute();
+    EXPECT_TRUE(chunked.has_value());
+    if (chunked.has_value()) {
+        EXPECT_TRUE(chunked->deferColumn(0).has_value());
+        EXPECT_TRUE(co_await chunked->next());
+        EXPECT_FALSE(chunked->getView(0).has_value());
+        std::vector<std::byte> read;
+        auto sink = [&](std::span<const std::byte> bytes) -> ILIAS_NAMESPACE::IoTask<void> {
+            EXPECT_LE(bytes.size(), 256 * 1024);
+            read.insert(read.end(), bytes.begin(), bytes.end());
+            co_return {};
+        };
+        auto written = co_await chunked->writeColumn(0, sink, 256 * 1024);
+        EXPECT_EQ(written.value_or(0), blob.size());
+        EXPECT_TRUE(read == blob);
+    }
+}
+
+TEST(SQL, statement) {
+    ilias_wait statementTest();
+}
+
+using BatchRow = std::tuple<int, std::string, std::optional<double>, SqlDate>;
+
+const std::vector<BatchRow> kBatchRows = {{1, "one", 1.5, SqlDate(2025, 1, 2, 3, 4, 5)},
+                                          {2, "two", std::nullopt, SqlDate(2025, 6, 7, 8, 9, 10)},
+                                          {3, "three", 3.5, SqlDate(2025, 11, 12, 13, 14, 15)}};
+
+// open db on the test database with a fresh table of kBatchRows, inserted by executeBatch.
+ILIAS_NAMESPACE::Task<bool> openBatchTable(SqlDatabase &db, const std::string &table) {
+    db.setHost("127.0.0.1");
+    db.setUserName("root");
+    db.setPassword("123456");
+    db.setPort(3306);
+    auto opened = co_await db.open();
+    EXPECT_TRUE(opened.has_value());
+    if (!opened.has_value()) {
+        co_return false;
+    }
+    SqlQuery query(db);
+    auto     ret = co_await query.execute("CREATE DATABASE IF NOT EXISTS test");
+    EXPECT_TRUE(ret.has_value());
+    opened = co_await db.selectDb("test");
+    ret    = co_await query.execute("DROP TABLE IF EXISTS " + table);
+    EXPECT_TRUE(ret.has_value());
+    ret = co_await query.execute("CREATE TABLE " + table +
+                                 " (id INT NOT NULL PRIMARY KEY, name VARCHAR(255), score DOUBLE, at DATETIME)");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return false;
+    }
+    opened = co_await query.prepare("INSERT INTO " + table + " (id, name, score, at) VALUES (?, ?, ?, ?)");
+    EXPECT_TRUE(opened.has_value());
+    if (!opened.has_value()) {
+        co_return false;
+    }
+    auto affected = co_await query.executeBatch(kBatchRows);
+    EXPECT_EQ(affected.value_or(0), kBatchRows.size());
+    co_return affected.has_value();
+}
+
+ILIAS_NAMESPACE::Task<void> batchTest() {
+    SqlDatabase db;
+    if (!co_await openBatchTable(db, "batch_table")) {
+        co_return;
+    }
+    SqlQuery query(db);
+    auto     ret = co_await query.execute("SELECT COUNT(*) AS total, COUNT(score) AS scored FROM batch_table");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    auto result = std::move(ret.value());
+    EXPECT_TRUE(co_await result.next());
+    EXPECT_EQ(result.get<int64_t>("total").value_or(0), 3);
+    EXPECT_EQ(result.get<int64_t>("scored").value_or(0), 2);
+
+    // every row got its own date.
+    ret = co_await query.execute("SELECT DATE_FORMAT(at, '%Y-%m-%d %H:%i:%s') FROM batch_table ORDER BY id");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    auto dates = std::move(ret.value());
+    for (auto expected : {"2025-01-02 03:04:05", "2025-06-07 08:09:10", "2025-11-12 13:14:15"}) {
+        EXPECT_TRUE(co_await dates.next());
+        EXPECT_EQ(dates.get<std::string>(0).value_or(""), expected);
+    }
+
+    // read back two rows per batch.
+    ret = co_await query.execute("SELECT id, name, score FROM batch_table ORDER BY id");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    auto   scan = std::move(ret.value());
+    size_t read = 0;
+    while (true) {
+        auto batch = co_await scan.nextBatch(2);
+        EXPECT_TRUE(batch.has_value());
+        if (!batch.has_value() || batch->empty()) {
+            break;
+        }
+        EXPECT_LE(batch->size(), 2);
+        for (size_t i = 0; i < batch->size(); ++i, ++read) {
+            auto row = (*batch)[i];
+            EXPECT_EQ(row.get<int>(0).value_or(0), std::get<0>(kBatchRows[read]));
+            EXPECT_EQ(row.get<std::string>(1).value_or(""), std::get<1>(kBatchRows[read]));
+            EXPECT_EQ(row.isNull(2), !std::get<2>(kBatchRows[read]).has_value());
+        }
+    }
+    EXPECT_EQ(read, kBatchRows.size());
+
+    ret = co_await query.execute("SELECT id, name, score FROM batch_table ORDER BY id");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    auto columns = co_await ret.value().toColumns();
+    EXPECT_TRUE(columns.has_value());
+    if (!columns.has_value()) {
+        co_return;
+    }
+    EXPECT_EQ(columns->size(), kBatchRows.size());
+    EXPECT_EQ(columns->column(0).kind(), SqlColumnData::Integer);
+    EXPECT_EQ(columns->column(0).integers()[2], 3);
+    EXPECT_EQ(columns->column("name")->text(1), "two");
+    EXPECT_EQ(columns->column("score")->nullCount(), 1);
+    EXPECT_TRUE(columns->column("score")->isNull(1));
+}
+
+TEST(SQL, batch) {
+    ilias_wait batchTest();
+}
+
+ILIAS_NAMESPACE::Task<void> exportTest() {
+    SqlDatabase db;
+    if (!co_await openBatchTable(db, "export_table")) {
+        co_return;
+    }
+    SqlQuery query(db);
+    // a schema message, two record batches of at most two rows, then the end marker.
+    auto ret = co_await query.execute("SELECT id, name, score FROM export_table ORDER BY id");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    std::vector<std::byte> stream;
+    size_t                 messages = 0;
+    auto sink = [&](std::span<const std::byte> bytes) -> ILIAS_NAMESPACE::IoTask<void> {
+        stream.insert(stream.end(), bytes.begin(), bytes.end());
+        ++messages;
+        co_return {};
+    };
+    auto written = co_await writeArrowStream(ret.value(), sink, 2);
+    EXPECT_EQ(written.value_or(0), kBatchRows.size());
+    EXPECT_EQ(messages, 4);
+    EXPECT_GE(stream.size(), 16);
+    if (stream.size() >= 16) {
+        EXPECT_EQ(stream[0], std::byte(0xFF));
+        EXPECT_EQ(stream[stream.size() - 8], std::byte(0xFF));
+        EXPECT_EQ(stream.back(), std::byte(0));
+    }
+
+    // no rows, the schema still has the columns.
+    ret = co_await query.execute("SELECT id, name, score FROM export_table WHERE 0");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    stream.clear();
+    messages = 0;
+    written  = co_await writeArrowStream(ret.value(), sink, 2);
+    EXPECT_TRUE(written.has_value());
+    EXPECT_EQ(written.value_or(1), 0);
+    EXPECT_EQ(messages, 2);
+    EXPECT_NE(std::string_view(reinterpret_cast<const char *>(stream.data()), stream.size()).find("score"),
+              std::string_view::npos);
+
+    // the first result set of the CALL fills the batch exactly, the second one is not part of its stream.
+    ret = co_await query.execute("DROP PROCEDURE IF EXISTS export_sets");
+    ret = co_await query.execute("CREATE PROCEDURE export_sets() BEGIN "
+                                 "SELECT id FROM export_table ORDER BY id LIMIT 2; SELECT name FROM export_table; END");
+    EXPECT_TRUE(ret.has_value());
+    ret = co_await query.execute("CALL export_sets()");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    auto sets = std::move(ret.value());
+    written   = co_await writeArrowStream(sets, sink, 2);
+    EXPECT_EQ(written.value_or(0), 2);
+    written = co_await writeArrowStream(sets, sink, 2);
+    EXPECT_EQ(written.value_or(0), kBatchRows.size());
+
+    ret = co_await query.execute("SELECT id, name, score FROM export_table ORDER BY id");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    std::string text;
+    auto        append = [&](std::span<const std::byte> bytes) -> ILIAS_NAMESPACE::IoTask<void> {
+        text.append(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+        co_return {};
+    };
+    SqlTextOptions options;
+    options.format    = SqlTextFormat::JsonLines;
+    options.batchRows = 2;
+    written           = co_await ret.value().writeText(append, options);
+    EXPECT_EQ(written.value_or(0), kBatchRows.size());
+    EXPECT_EQ(text, "{\"id\":1,\"name\":\"one\",\"score\":1.5}\n"
+                    "{\"id\":2,\"name\":\"two\",\"score\":null}\n"
+                    "{\"id\":3,\"name\":\"three\",\"score\":3.5}\n");
+
+    // bytes are not UTF-8, a JSON string of them is base64.
+    ret = co_await query.execute("SELECT CAST('ab' AS BINARY) AS raw");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    text.clear();
+    written = co_await ret.value().writeText(append, options);
+    EXPECT_EQ(text, "{\"raw\":\"YWI=\"}\n");
+
+    // the csv of the first result set of the CALL ends with it, even when it fills the last batch exactly.
+    ret = co_await query.execute("CALL export_sets()");
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    text.clear();
+    written = co_await ret.value().writeText(append, SqlTextOptions {.batchRows = 2});
+    EXPECT_EQ(written.value_or(0), 2);
+    EXPECT_EQ(text, "id\n1\n2\n");
+}
+
+TEST(SQL, exportRows) {
+    ilias_wait exportTest();
+}
+
+ILIAS_NAMESPACE::Task<void> pipelineTest() {
+    SqlDatabase db;
+    if (!co_await openBatchTable(db, "pipeline_table")) {
+        co_return;
+    }
+    // a failed query in the middle doesn't stop the ones after it.
+    auto pipeline = db.pipeline();
+    pipeline.add("SELECT COUNT(*) FROM pipeline_table");
+    pipeline.add("SELECT no_such_column FROM pipeline_table");
+    pipeline.add("SELECT name FROM pipeline_table WHERE id = 2");
+    auto results = co_await pipeline.run();
+    EXPECT_EQ(results.size(), 3);
+    if (results.size() != 3) {
+        co_return;
+    }
+    EXPECT_TRUE(results[0].has_value() && co_await results[0]->next());
+    EXPECT_EQ(results[0]->get<int64_t>(0).value_or(0), 3);
+    EXPECT_FALSE(results[1].has_value());
+    EXPECT_TRUE(results[2].has_value() && co_await results[2]->next());
+    EXPECT_EQ(results[2]->get<std::string>(0).value_or(""), "two");
+}
+
+TEST(SQL, pipeline) {
+    ilias_wait pipelineTest();
+}
+
+ILIAS_NAMESPACE::Task<void> multiTest() {
+    SqlDatabase db;
+    if (!co_await openBatchTable(db, "multi_table")) {
+        co_return;
+    }
+    SqlQuery query(db);
+    auto     multi = co_await query.executeMulti(std::vector<std::string_view> {
+        "UPDATE multi_table SET score = 2.5 WHERE id = 2", "SELECT name FROM multi_table WHERE id = 2",
+        "DELETE FROM multi_table WHERE id = 99"});
+    EXPECT_TRUE(multi.has_value());
+    if (!multi.has_value()) {
+        co_return;
+    }
+    EXPECT_EQ(multi->index(), 0);
+    EXPECT_FALSE(multi->hasRows());
+    EXPECT_EQ(multi->affectedRows(), 1);
+    EXPECT_TRUE((co_await multi->nextResult()).value_or(false));
+    EXPECT_TRUE(multi->hasRows());
+    auto rows = multi->result();
+    EXPECT_NE(rows, nullptr);
+    if (rows == nullptr) {
+        co_return;
+    }
+    EXPECT_TRUE(co_await rows->next());
+    EXPECT_EQ(rows->get<std::string>(0).value_or(""), "two");
+    EXPECT_FALSE(co_await rows->next());
+    EXPECT_TRUE((co_await multi->nextResult()).value_or(false));
+    EXPECT_EQ(multi->index(), 2);
+    EXPECT_EQ(multi->affectedRows(), 0);
+    EXPECT_FALSE((co_await multi->nextResult()).value_or(true));
+    EXPECT_EQ(multi->result(), nullptr);
+
+    // multiple statements were only on for executeMulti().
+    auto chained = co_await query.execute("SELECT 1; SELECT 2");
+    EXPECT_FALSE(chained.has_value());
+
+    // a cursor replaced before its results are read leaves them to its connection.
+    SqlDatabase other;
+    if (!co_await openBatchTable(other, "multi_other")) {
+        co_return;
+    }
+    SqlQuery otherQuery(other);
+    auto     replaced = co_await query.executeMulti("SELECT 1; SELECT 2; SELECT 3");
+    auto     replacer = co_await otherQuery.executeMulti("SELECT 4; SELECT 5");
+    EXPECT_TRUE(replaced.has_value() && replacer.has_value());
+    if (!replaced.has_value() || !replacer.has_value()) {
+        co_return;
+    }
+    *replaced = std::move(*replacer);
+    EXPECT_NE(replaced->result(), nullptr);
+    if (replaced->result() == nullptr) {
+        co_return;
+    }
+    EXPECT_TRUE(co_await replaced->result()->next());
+    EXPECT_EQ(replaced->result()->get<int64_t>(0).value_or(0), 4);
+    auto after = co_await query.execute("SELECT 6");
+    EXPECT_TRUE(after.has_value());
+}
+
+TEST(SQL, multi) {
+    ilias_wait multiTest();
+}
+
+ILIAS_NAMESPACE::Task<void> execTest() {
+    SqlDatabase db;
+    if (!co_await openBatchTable(db, "exec_table")) {
+        co_return;
+    }
+    SqlQuery query(db);
+    auto     info = co_await query.exec("INSERT INTO exec_table (id, name, score) VALUES (4, 'four', NULL)");
+    EXPECT_TRUE(info.has_value());
+    EXPECT_EQ(info.value_or(SqlExecInfo {}).affectedRows, 1);
+    info = co_await query.exec("SELECT id FROM exec_table");
+    EXPECT_EQ(info.value_or(SqlExecInfo {}).affectedRows, 4);
+}
+
+TEST(SQL, exec) {
+    ilias_wait execTest();
+}
+
+ILIAS_NAMESPACE::Task<void> streamTest() {
+    SqlDatabase db;
+    db.setHost("127.0.0.1");
+    db.setUserName("root");
+    db.setPassword("123456");
+    db.setPort(3306);
+    auto ret1 = co_await db.open();
+    EXPECT_TRUE(ret1.has_value());
+    if (!ret1.has_value()) {
+        co_return;
+    }
+    SqlQuery query(db);
+    for (auto mode : {SqlResultMode::Streaming, SqlResultMode::Cursor}) {
+        auto ret = co_await query.execute("SELECT 1 AS seq UNION ALL SELECT 2 UNION ALL SELECT 3", mode);
+        EXPECT_TRUE(ret.has_value());
+        if (!ret.has_value()) {
+            co_return;
+        }
+        auto result = std::move(ret.value());
+        int  rows   = 0;
+        while (co_await result.next()) {
+            ++rows;
+        }
+        EXPECT_EQ(rows, 3);
+    }
+    // the same rows through the async range, two per read ahead.
+    {
+        auto ret = co_await query.execute("SELECT 1 AS seq UNION ALL SELECT 2 UNION ALL SELECT 3",
+                                          SqlResultMode::Streaming);
+        EXPECT_TRUE(ret.has_value());
+        if (!ret.has_value()) {
+            co_return;
+        }
+        auto result = std::move(ret.value());
+        auto rows   = result.rows(2);
+        int  sum    = 0;
+        for (auto it = co_await rows.begin(); it.has_value() && *it != rows.end(); (void)co_await ++*it) {
+            sum += (int)(*it)->get<int64_t>(0).value_or(0);
+        }
+        EXPECT_EQ(sum, 6);
+    }
+    // left unread, the connection skips the rest or closes the cursor before its next command.
+    for (auto mode : {SqlResultMode::Streaming, SqlResultMode::Cursor}) {
+        {
+            auto ret = co_await query.execute("SELECT 1 UNION ALL SELECT 2", mode);
+            EXPECT_TRUE(ret.has_value());
+        }
+        auto ret = co_await query.execute("SELECT 1");
+        EXPECT_TRUE(ret.has_value());
+    }
+    // the reaper leaves a connection in use to its next command, it settles and closes one nobody holds.
+    {
+        auto ret = co_await query.execute("SELECT 1 UNION ALL SELECT 2", SqlResultMode::Streaming);
+        EXPECT_TRUE(ret.has_value());
+    }
+    {
+        SqlDatabase dropped;
+        dropped.setHost("127.0.0.1");
+        dropped.setUserName("root");
+        dropped.setPassword("123456");
+        dropped.setPort(3306);
+        auto opened = co_await dropped.open();
+        EXPECT_TRUE(opened.has_value());
+        if (!opened.has_value()) {
+            co_return;
+        }
+        SqlQuery droppedQuery(dropped);
+        auto     unread = co_await droppedQuery.execute("SELECT 1 UNION ALL SELECT 2", SqlResultMode::Streaming);
+        EXPECT_TRUE(unread.has_value());
+    }
+    auto &reaper  = ILIAS_SQL_COMPLETE_NAMESPACE::detail::SqlReaper::current();
+    auto  drained = co_await reaper.drain();
+    EXPECT_TRUE(drained.has_value());
+    EXPECT_TRUE(reaper.idle());
+    auto ret = co_await query.execute("SELECT 1");
+    EXPECT_TRUE(ret.has_value());
+}
+
+TEST(SQL, stream) {
+    ilias_wait streamTest();
+}
+
+TEST(SQL, parse) {
+    using namespace ILIAS_SQL_COMPLETE_NAMESPACE::detail;
+    int64_t  value  = 0;
+    uint64_t bigint = 0;
+    int8_t   tiny   = 0;
+    EXPECT_TRUE(parseInteger("-9223372036854775808", value));
+    EXPECT_EQ(value, INT64_MIN);
+    EXPECT_FALSE(parseInteger("9223372036854775808", value));
+    EXPECT_TRUE(parseInteger("18446744073709551615", bigint));
+    EXPECT_EQ(bigint, UINT64_MAX);
+    EXPECT_TRUE(parseInteger("0000000000000000000000123456789", value));
+    EXPECT_EQ(value, 123456789);
+    EXPECT_FALSE(parseInteger("128", tiny));
+    EXPECT_FALSE(parseInteger("12a45678", value));
+
+    MYSQL_TIME time;
+    EXPECT_TRUE(parseTemporal("2025-06-20 01:02:03.25", MYSQL_TYPE_DATETIME, time));
+    EXPECT_EQ(time.year, 2025u);
+    EXPECT_EQ(time.second, 3u);
+    EXPECT_EQ(time.second_part, 250000u);
+    EXPECT_TRUE(parseTemporal("-838:59:59", MYSQL_TYPE_TIME, time));
+    EXPECT_TRUE(time.neg);
+    EXPECT_EQ(time.hour, 838u);
+    EXPECT_FALSE(parseTemporal("2025-06-20 01:02", MYSQL_TYPE_DATETIME, time));
+}
+
+TEST(SQL, stmtCache) {
+    using namespace ILIAS_SQL_COMPLETE_NAMESPACE::detail;
+    MYSQL_STMT                stmts[4] {};
+    std::vector<MYSQL_STMT *> closed;
+    SqlStmtCache              cache(2);
+    cache.setCloser([&](MYSQL_STMT *stmt) { closed.push_back(stmt); });
+
+    // a released statement is a hit, one in use isn't handed out twice.
+    EXPECT_TRUE(cache.insert("SELECT 1", &stmts[0]));
+    EXPECT_EQ(cache.acquire("SELECT 1"), nullptr);
+    EXPECT_TRUE(cache.release(&stmts[0]));
+    EXPECT_EQ(cache.acquire("SELECT 1"), &stmts[0]);
+    EXPECT_TRUE(cache.release(&stmts[0]));
+
+    // full, the least recently used idle statement is closed.
+    EXPECT_TRUE(cache.insert("SELECT 2", &stmts[1]));
+    EXPECT_TRUE(cache.release(&stmts[1]));
+    EXPECT_EQ(cache.acquire("SELECT 1"), &stmts[0]);
+    EXPECT_TRUE(cache.release(&stmts[0]));
+    EXPECT_TRUE(cache.insert("SELECT 3", &stmts[2]));
+    EXPECT_EQ(closed, (std::vector<MYSQL_STMT *> {&stmts[1]}));
+    EXPECT_EQ(cache.acquire("SELECT 2"), nullptr);
+    EXPECT_FALSE(cache.owns(&stmts[1]));
+
+    // statements in use are never evicted, a new one that doesn't fit stays with its caller.
+    EXPECT_EQ(cache.acquire("SELECT 1"), &stmts[0]);
+    EXPECT_FALSE(cache.insert("SELECT 4", &stmts[3]));
+    EXPECT_FALSE(cache.release(&stmts[3]));
+    EXPECT_EQ(cache.size(), 2u);
+
+    // the shrink of the prepare retry after MAX_PREPARED_STMT_COUNT_REACHED only closes idle statements.
+    EXPECT_TRUE(cache.release(&stmts[0]));
+    cache.setCapacity(cache.size() / 2);
+    EXPECT_EQ(closed.back(), &stmts[0]);
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_TRUE(cache.release(&stmts[2]));
+    cache.setCapacity(0);
+    EXPECT_EQ(closed.size(), 3u);
+    EXPECT_EQ(cache.size(), 0u);
+
+    // clear() closes the idle statements through the closer as well, detach() hands them back instead.
+    cache.setCapacity(2);
+    EXPECT_TRUE(cache.insert("SELECT 1", &stmts[0]));
+    EXPECT_TRUE(cache.insert("SELECT 2", &stmts[1]));
+    EXPECT_TRUE(cache.release(&stmts[0]));
+    cache.clear();
+    EXPECT_EQ(closed.back(), &stmts[0]);
+    EXPECT_EQ(closed.size(), 4u);
+    EXPECT_FALSE(cache.release(&stmts[1]));
+    EXPECT_TRUE(cache.insert("SELECT 3", &stmts[2]));
+    EXPECT_TRUE(cache.release(&stmts[2]));
+    EXPECT_EQ(cache.detach(), (std::vector<MYSQL_STMT *> {&stmts[2]}));
+    EXPECT_EQ(closed.size(), 4u);
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+ILIAS_NAMESPACE::Task<void> stmtLimitTest() {
+    SqlDatabase db;
+    db.setHost("127.0.0.1");
+    db.setUserName("root");
+    db.setPassword("123456");
+    db.setPort(3306);
+    auto ret = co_await db.open();
+    EXPECT_TRUE(ret.has_value());
+    if (!ret.has_value()) {
+        co_return;
+    }
+    // the statements of the connections closed by the other tests count too.
+    auto drained = co_await ILIAS_SQL_COMPLETE_NAMESPACE::detail::SqlReaper::current().drain();
+    EXPECT_TRUE(drained.has_value());
+    SqlQuery admin(db);
+    auto     limit = co_await admin.exec("SET GLOBAL max_prepared_stmt_count = 2");
+    EXPECT_TRUE(limit.has_value());
+    if (!limit.has_value()) {
+        co_return;
+    }
+    // the third statement hits the limit, the cache gives back its idle statements and the prepare is retried.
+    SqlQuery query(db);
+    for (int i = 0; i < 4; ++i) {
+        auto prepared = co_await query.prepare("SELECT " + std::to_string(i) + " + ?");
+        EXPECT_TRUE(prepared.has_value());
+    }
+    auto reset = co_await admin.exec("SET GLOBAL max_prepared_stmt_count = DEFAULT");
+    EXPECT_TRUE(reset.has_value());
+}
+
+TEST(SQL, stmtLimit) {
+    ilias_wait stmtLimitTest();
+}
+
+TEST(SQL, resolver) {
+    using namespace ILIAS_SQL_COMPLETE_NAMESPACE::detail;
+    EXPECT_TRUE(SqlResolver::isLiteral(""));
+    EXPECT_TRUE(SqlResolver::isLiteral("localhost"));
+    EXPECT_TRUE(SqlResolver::isLiteral("127.0.0.1"));
+    EXPECT_TRUE(SqlResolver::isLiteral("::1"));
+    EXPECT_FALSE(SqlResolver::isLiteral("db1.example.com"));
+}
+
+ILIAS_NAMESPACE::Task<void> resolveTest() {
+    using namespace ILIAS_SQL_COMPLETE_NAMESPACE::detail;
+    using Addresses = std::vector<std::string>;
+    SqlResolver            resolver;
+    ILIAS_NAMESPACE::Event gate;
+    int                    lookups = 0;
+    bool                   gated   = false;
+    resolver.setLookup([&](std::string) -> ILIAS_NAMESPACE::IoTask<Addresses> {
+        ++lookups;
+        if (gated) {
+            co_await gate;
+        }
+        co_return Addresses {"10.0.0.1", "10.0.0.2"};
+    });
+
+    // cached for the ttl, every resolve starts at the next address.
+    auto first  = co_await resolver.resolve("db.example");
+    auto second = co_await resolver.resolve("db.example");
+    auto third  = co_await resolver.resolve("db.example");
+    EXPECT_EQ(lookups, 1);
+    EXPECT_EQ(first.value_or(Addresses {}), (Addresses {"10.0.0.1", "10.0.0.2"}));
+    EXPECT_EQ(second.value_or(Addresses {}), (Addresses {"10.0.0.2", "10.0.0.1"}));
+    EXPECT_EQ(third.value_or(Addresses {}), (Addresses {"10.0.0.1", "10.0.0.2"}));
+
+    // forgotten, the host is looked up again.
+    resolver.forget("db.example");
+    auto again = co_await resolver.resolve("db.example");
+    EXPECT_TRUE(again.has_value());
+    EXPECT_EQ(lookups, 2);
+
+    // expired as well.
+    resolver.setTtl(std::chrono::milliseconds(0));
+    for (int i = 0; i < 2; ++i) {
+        auto expired = co_await resolver.resolve("db.example");
+        EXPECT_TRUE(expired.has_value());
+    }
+    EXPECT_EQ(lookups, 4);
+
+    // the resolves during a lookup wait for it, each one still gets its own first address.
+    resolver.setTtl(std::chrono::seconds(30));
+    resolver.forget();
+    gated        = true;
+    auto open    = [&]() -> ILIAS_NAMESPACE::Task<void> {
+        gate.set();
+        co_return;
+    };
+    auto results = co_await whenAll(resolver.resolve("db.example"), resolver.resolve("db.example"), open());
+    auto &shared = std::get<0>(results);
+    auto &waiter = std::get<1>(results);
+    EXPECT_EQ(lookups, 5);
+    EXPECT_EQ(shared.value_or(Addresses {}), (Addresses {"10.0.0.1", "10.0.0.2"}));
+    EXPECT_EQ(waiter.value_or(Addresses {}), (Addresses {"10.0.0.2", "10.0.0.1"}));
+}
+
+TEST(SQL, resolve) {
+    ilias_wait resolveTest();
+}
+
 int main(int argc, char **argv) {
     ILIAS_LOG_SET_LEVEL(ILIAS_TRACE_LEVEL);
     ilias::PlatformContext ioContext;
     ::testing::InitGoogleTest(&argc, argv);
-    return RUN_ALL_TESTS();
+    auto ret = RUN_ALL_TESTS();
+    // the connections of the last test are still closing, they must be gone before the context.
+    ilias_wait ILIAS_SQL_COMPLETE_NAMESPACE::detail::SqlReaper::current().drain();
+    return ret;
     return 0;
 }
\ No newline at end of file